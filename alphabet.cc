@@ -0,0 +1,213 @@
+/* alphabet.cc: the Alphabet class.
+
+   Copyright 2012 Kenneth S. Brown.
+
+   This file is part of Toddcox.
+
+   Toddcox is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version (GPLv3+).
+
+   Toddcox is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Toddcox; if not, see <http://gnu.org/licenses/>.
+
+   Written by Ken Brown <kbrown@cornell.edu>. */
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cctype>
+#include <cstdlib>
+#include <cerrno>
+
+#include "alphabet.h"
+#include "gens_and_words.h"
+
+using namespace std;
+
+// The default names: a,b,... if there are few enough generators,
+// otherwise x1,x2,...
+Alphabet::Alphabet (int n)
+{
+  for (int i = 0; i < n; i++)
+    {
+      ostringstream os;
+      if (n <= 26)
+	os << char ('a' + i);
+      else
+	os << "x" << i + 1;
+      gen_names.push_back (os.str ());
+    }
+  init ();
+}
+
+// The caller should check that the names are valid and distinct.
+Alphabet::Alphabet (const vector<string>& names)
+  : gen_names (names)
+{
+  init ();
+}
+
+// On entry gen_names holds the names of the generators only.  Expand
+// it to include the inverses and build the lookup tables.  The names
+// of the generators are entered first, so that the inverse of one
+// generator can't hide another.
+void
+Alphabet::init ()
+{
+  const vector<string> g = gen_names;
+  const int n = g.size ();
+  gen_names.assign (2 * n, "");
+  for (int c = 0; c < 256; c++)
+    by_char[c] = NOTAGEN;
+  by_name.clear ();
+  letters = true;
+  for (int i = 0; i < n; i++)
+    {
+      gen_names[2 * i] = g[i];
+      by_name[g[i]] = 2 * i;
+      if (g[i].size () == 1)
+	by_char[(unsigned char) g[i][0]] = 2 * i;
+      else
+	letters = false;
+    }
+  for (int i = 0; i < n; i++)
+    {
+      string s = g[i];
+      for (size_t j = 0; j < s.size (); j++)
+	s[j] = switch_case (s[j]);
+      if (s != g[i] && by_name.count (s) == 0)
+	{
+	  by_name[s] = 2 * i + 1;
+	  if (s.size () == 1)
+	    by_char[(unsigned char) s[0]] = 2 * i + 1;
+	}
+      else
+	s = g[i] + "^-1";
+      gen_names[2 * i + 1] = s;
+    }
+}
+
+vector<string>
+Alphabet::names () const
+{
+  vector<string> v;
+  for (int x = 0; x < size (); x += 2)
+    v.push_back (gen_names[x]);
+  return v;
+}
+
+int
+Alphabet::name_to_gen (const string& s) const
+{
+  if (s.size () == 1)
+    return char_to_gen (s[0]);
+  unordered_map<string, int>::const_iterator it = by_name.find (s);
+  return it == by_name.end () ? NOTAGEN : it->second;
+}
+
+// A name is a letter followed by letters, digits and underscores.
+bool
+Alphabet::valid_name (const string& s)
+{
+  if (s.empty () || !isalpha ((unsigned char) s[0]))
+    return false;
+  for (size_t i = 1; i < s.size (); i++)
+    if (!isalnum ((unsigned char) s[i]) && s[i] != '_')
+      return false;
+  return true;
+}
+
+static bool
+is_name_char (char c)
+{
+  return isalnum ((unsigned char) c) || c == '_';
+}
+
+// Parse a sequence of factors, each a generator or a parenthesized
+// sequence, optionally followed by ^ and an integer, starting at
+// s[i].  Stop at the end of s or at an unmatched ')', leaving i
+// there, and append the result to w.  Fail if w would grow beyond
+// MAX_WORD_LENGTH letters, so that a huge exponent can't exhaust
+// memory.
+bool
+Alphabet::parse (word& w, const string& s, size_t& i) const
+{
+  while (true)
+    {
+      while (i < s.size () && (isspace ((unsigned char) s[i]) || s[i] == '*'))
+	i++;
+      if (i == s.size () || s[i] == ')')
+	return true;
+      word f;
+      if (s[i] == '(')
+	{
+	  if (!parse (f, s, ++i) || i == s.size ())
+	    return false;
+	  i++;			// skip ')'
+	}
+      else
+	{
+	  size_t j = i + 1;
+	  if (!letters)
+	    while (j < s.size () && is_name_char (s[j]))
+	      j++;
+	  int x = (j == i + 1 ? char_to_gen (s[i])
+		   : name_to_gen (s.substr (i, j - i)));
+	  if (x == NOTAGEN)
+	    return false;
+	  f.push_back (x);
+	  i = j;
+	}
+      long k = 1;
+      if (i < s.size () && s[i] == '^')
+	{
+	  const char* start = s.c_str () + i + 1;
+	  char* end;
+	  errno = 0;
+	  k = strtol (start, &end, 10);
+	  if (end == start || isspace ((unsigned char) *start)
+	      || errno == ERANGE || k < -MAX_WORD_LENGTH
+	      || k > MAX_WORD_LENGTH)
+	    return false;
+	  i += 1 + (end - start);
+	}
+      if (k < 0)
+	{
+	  f = inverse (f);
+	  k = -k;
+	}
+      if (long (f.size ()) * k > MAX_WORD_LENGTH - long (w.size ()))
+	return false;
+      for (long e = 0; e < k; e++)
+	w.insert (w.end (), f.begin (), f.end ());
+    }
+}
+
+// Translate s into w, returning false if s is not a valid word.
+bool
+Alphabet::string_to_word (word& w, const string& s) const
+{
+  size_t i = 0;
+  w.clear ();
+  return parse (w, s, i) && i == s.size ();
+}
+
+string
+Alphabet::word_to_string (const word& w) const
+{
+  string s;
+  for (size_t i = 0; i < w.size (); i++)
+    {
+      if (i > 0 && !letters)
+	s += '*';
+      s += gen_names[w[i]];
+    }
+  return s;
+}
@@ -0,0 +1,71 @@
+/* alphabet.h: declarations for the Alphabet class.
+
+   Copyright 2012 Kenneth S. Brown.
+
+   This file is part of Toddcox.
+
+   Toddcox is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version (GPLv3+).
+
+   Toddcox is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Toddcox; if not, see <http://gnu.org/licenses/>.
+
+   Written by Ken Brown <kbrown@cornell.edu>. */
+
+#ifndef ALPHABET_H
+#define ALPHABET_H
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+#include "gens_and_words.h"
+
+/* An Alphabet names the generators of a group and translates between
+   strings and words.  Generator i is represented internally by 2i and
+   its inverse by 2i + 1, and size () counts both.  With n <= 26
+   generators and no names given, the generators are a,b,... as
+   always; beyond that they are x1,x2,...  The inverse of a generator
+   is written by switching the case of its name (so A, X1), unless
+   that is itself a name, or by appending ^-1.
+
+   If every name is a single letter, a word is a string of letters,
+   e.g. abAB.  Otherwise names are separated by spaces or *, e.g.
+   x1 x2 X1 or x1*x2.  In either case a generator or a parenthesized
+   subword can be raised to an integer power, e.g. a^11 or
+   (x1 x2)^-3, as long as the word stays within MAX_WORD_LENGTH
+   letters.  word_to_string writes a word in the form abAB or
+   x1*x2*X1.  Looking up a single letter takes constant time, and so
+   does looking up a longer name, on average. */
+
+class Alphabet
+{
+ public:
+  enum {MAX_WORD_LENGTH = 1 << 24};
+  explicit Alphabet (int n = 0);
+  explicit Alphabet (const std::vector<std::string>& names);
+  int size () const { return gen_names.size (); }
+  const std::string& name (int x) const { return gen_names[x]; }
+  std::vector<std::string> names () const;
+  int char_to_gen (char c) const { return by_char[(unsigned char) c]; }
+  int name_to_gen (const std::string& s) const;
+  bool string_to_word (word& w, const std::string& s) const;
+  std::string word_to_string (const word& w) const;
+  static bool valid_name (const std::string& s);
+ private:
+  std::vector<std::string> gen_names; /* 2n entries, inverses included */
+  int by_char[256];		      /* single-letter names */
+  std::unordered_map<std::string, int> by_name;	/* longer names */
+  bool letters;			/* every name is a single letter */
+  void init ();
+  bool parse (word& w, const std::string& s, size_t& i) const;
+};
+
+#endif	/* ALPHABET_H */
@@ -0,0 +1,209 @@
+/* batch.cc: implementation of run_batch.
+
+   Copyright 2012 Kenneth S. Brown.
+
+   This file is part of Toddcox.
+
+   Toddcox is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version (GPLv3+).
+
+   Toddcox is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Toddcox; if not, see <http://gnu.org/licenses/>.
+
+   Written by Ken Brown <kbrown@cornell.edu>. */
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <new>
+#include <cstdlib>
+#include <cctype>
+
+#include "batch.h"
+#include "cosettable.h"
+#include "gens_and_words.h"
+#include "alphabet.h"
+#include "workerpool.h"
+
+using namespace std;
+
+struct Group
+{
+  Alphabet alphabet;
+  vector<string> rel;
+};
+
+struct Job
+{
+  string name;
+  const Group* group;
+  int method;			/* as for CosetTableBase::enumerate */
+  Strategy strategy;		/* if method is HYBRID */
+  vector<string> gen_H;
+};
+
+// Split a comma-separated list of words, checking each one.
+static bool
+parse_words (const string& list, const Alphabet& A, vector<string>& v)
+{
+  if (list == "-")
+    return true;
+  istringstream is (list);
+  string s;
+  while (getline (is, s, ','))
+    {
+      word w;
+      if (s.empty () || !A.string_to_word (w, s))
+	return false;
+      v.push_back (s);
+    }
+  return true;
+}
+
+// The generators are given by their number or by a comma-separated
+// list of their names.
+static bool
+parse_gens (const string& s, Alphabet& A)
+{
+  if (isdigit ((unsigned char) s[0]))
+    return parse_generators (s, A);
+  istringstream is (s);
+  string name, line;
+  int n = 0;
+  while (getline (is, name, ','))
+    {
+      line += " " + name;
+      n++;
+    }
+  return parse_generators (to_string (n) + line, A);
+}
+
+static bool
+parse_method (const string& s, int& method, Strategy& strategy)
+{
+  if (s == "hlt")
+    method = 0;
+  else if (s == "felsch")
+    method = CosetTableBase::FELSCH;
+  else if (s.compare (0, 7, "hybrid:") == 0)
+    {
+      method = CosetTableBase::HYBRID;
+      return parse_strategy (s.substr (7), strategy);
+    }
+  else if (s.compare (0, 4, "hlt+") == 0)
+    return (method = atoi (s.c_str () + 4)) > 0;
+  else
+    return false;
+  return true;
+}
+
+// Read the manifest into groups and jobs.  Return false, after a
+// message, if it is malformed.
+static bool
+read_manifest (istream& in, map<string, Group>& groups, vector<Job>& jobs)
+{
+  string line;
+  for (int lineno = 1; getline (in, line); lineno++)
+    {
+      istringstream is (line);
+      string kind, name, a, b, c, extra;
+      if (!(is >> kind) || kind[0] == '#')
+	continue;
+      bool ok = bool (is >> name);
+      if (ok && kind == "group")
+	{
+	  if (groups.count (name))
+	    {
+	      cerr << "Manifest line " << lineno << " defines group "
+		   << name << " again:\n" << line << endl;
+	      return false;
+	    }
+	  Group& g = groups[name];
+	  ok = ((is >> a >> b) && !(is >> extra) && parse_gens (a, g.alphabet)
+		&& parse_words (b, g.alphabet, g.rel));
+	}
+      else if (ok && kind == "job")
+	{
+	  Job j;
+	  j.name = name;
+	  ok = ((is >> a >> b >> c) && !(is >> extra) && groups.count (a)
+		&& parse_method (b, j.method, j.strategy));
+	  if (ok)
+	    {
+	      j.group = &groups[a];
+	      ok = parse_words (c, j.group->alphabet, j.gen_H);
+	      jobs.push_back (j);
+	    }
+	}
+      else
+	ok = false;
+      if (!ok)
+	{
+	  cerr << "Manifest line " << lineno << " is invalid:\n"
+	       << line << endl;
+	  return false;
+	}
+    }
+  return true;
+}
+
+int
+run_batch (istream& manifest, ostream& out, int nthreads, long maxcosets)
+{
+  map<string, Group> groups;
+  vector<Job> jobs;
+  if (!read_manifest (manifest, groups, jobs))
+    return -1;
+  mutex m;
+  int nfailed = 0;
+  WorkerPool pool (nthreads);
+  out << "# name\tstatus\tindex\ttable size\tcosets defined" << endl;
+  pool.run (jobs.size (), [&] (int i)
+    {
+      const Job& j = jobs[i];
+      ostringstream result;
+      result << j.name << "\t";
+      CosetTableBase* ctp = 0;
+      bool failed = true;
+      try
+	{
+	  ctp = new_coset_table (j.group->alphabet, j.group->rel, j.gen_H,
+				 j.method, maxcosets);
+	  ctp->set_verbose (false);
+	  if (j.method == CosetTableBase::HYBRID)
+	    ctp->set_strategy (j.strategy);
+	  ctp->enumerate (j.method);
+	  result << "ok\t" << ctp->getnlive () << "\t" << ctp->getsize ()
+		 << "\t" << ctp->getstats ().defined;
+	  failed = false;
+	}
+      catch (CosetTableBase::Enumeration_Failed& e)
+	{
+	  string reason = e.reason;
+	  for (size_t k = 0; k < reason.size (); k++)
+	    if (reason[k] == '\n')
+	      reason[k] = ' ';
+	  result << "failed\t" << reason;
+	}
+      catch (bad_alloc&)
+	{
+	  result << "failed\tMemory exhausted.";
+	}
+      delete ctp;
+      lock_guard<mutex> lock (m);
+      if (failed)
+	nfailed++;
+      out << result.str () << endl;
+    });
+  return nfailed;
+}
@@ -0,0 +1,63 @@
+/* batch.h: running many enumerations at once.
+
+   Copyright 2012 Kenneth S. Brown.
+
+   This file is part of Toddcox.
+
+   Toddcox is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version (GPLv3+).
+
+   Toddcox is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Toddcox; if not, see <http://gnu.org/licenses/>.
+
+   Written by Ken Brown <kbrown@cornell.edu>. */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <iostream>
+
+/* run_batch reads a manifest of jobs and runs them on nthreads
+   threads, each job with its own coset table.  The manifest is a
+   text file with one item per line; blank lines and lines starting
+   with # are ignored.  A group is given by
+
+     group NAME GENERATORS RELATORS
+
+   and an enumeration by
+
+     job NAME GROUP METHOD SUBGROUP
+
+   where GENERATORS is the number of generators or a comma-separated
+   list of their names, RELATORS and SUBGROUP are comma-separated
+   lists of words (or - for an empty list) as described in
+   alphabet.h, but using * rather than spaces to separate names,
+   GROUP is the name of a group given earlier (each group name may
+   be given only once), and METHOD is hlt, felsch, hlt+THRESHOLD or
+   hybrid:H,F[,L] (see parse_strategy in cosettable.h).  For
+   example:
+
+     group A4 2 aaa,bbb,abab
+     job A4_1 A4 hlt -
+     job A4_a A4 felsch a
+     group S4 s,t,u s^2,t^2,u^2,(s*t)^3,(t*u)^3,(s*u)^2
+     job S4_st S4 hlt s,t
+
+   For each job, one tab-separated line is written to out as soon as
+   the job finishes: the name, then either "ok", the index, the
+   table size before compression and the number of cosets defined,
+   or "failed" and the reason.  Maxcosets limits each table as in
+   new_coset_table.  Return the number of jobs that failed, or -1
+   (after a message on cerr) if the manifest is malformed. */
+
+int run_batch (std::istream& manifest, std::ostream& out, int nthreads,
+	       long maxcosets = 0);
+
+#endif	/* BATCH_H */
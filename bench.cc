@@ -0,0 +1,328 @@
+/* bench.cc: A benchmark driver for the Todd-Coxeter routines.
+
+   Copyright 2012 Kenneth S. Brown.
+
+   This file is part of Toddcox.
+
+   Toddcox is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version (GPLv3+).
+
+   Toddcox is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Toddcox; if not, see <http://gnu.org/licenses/>.
+
+   Written by Ken Brown <kbrown@cornell.edu>. */
+
+// Run each enumeration method (HLT, HLT+lookahead at several
+// thresholds, Felsch, and any hybrid strategies asked for) on each
+// input file given on the command line, and record the wall time,
+// peak resident set size, maximum table size, maximum number of live
+// cosets and number of cosets defined.  Each run takes place in a
+// child process, so that its peak memory can be measured separately.
+// The results are written in JSON format, for comparison between
+// releases and across machines.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstdio>
+#include <ctime>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "tc.h"
+#include <config.h>
+
+using namespace std;
+
+struct Result
+{
+  bool ok;
+  long index;
+  long max_rows;
+  long max_live;
+  unsigned long defined;
+  double seconds;
+  long rss_kb;
+};
+
+void usage ();
+void parse_args (int, char **, string&, vector<int>&, vector<string>&,
+		 int&);
+bool run_one (const string&, int, const Strategy&, int, Result&);
+string example_name (const string&);
+
+static string progname;
+
+int
+main (int argc, char *argv[])
+{
+  string outfile = "bench-results.json";
+  vector<int> thresholds;
+  vector<string> strategies;
+  int nthreads = 1;
+
+  progname = argv[0];
+  parse_args (argc, argv, outfile, thresholds, strategies, nthreads);
+  if (thresholds.empty ())
+    {
+      thresholds.push_back (20000);
+      thresholds.push_back (200000);
+      thresholds.push_back (2000000);
+    }
+
+  ofstream out (outfile.c_str ());
+  if (!out)
+    {
+      cerr << "Unable to open " << outfile << endl;
+      exit (1);
+    }
+  char host[256] = "unknown";
+  gethostname (host, sizeof host - 1);
+  out << "{\n  \"package\": \"" << PACKAGE_STRING << "\",\n"
+      << "  \"host\": \"" << host << "\",\n"
+      << "  \"date\": " << time (0) << ",\n"
+      << "  \"threads\": " << nthreads << ",\n"
+      << "  \"runs\": [";
+
+  cout << left << setw (10) << "example" << setw (16) << "method"
+       << right << setw (10) << "seconds" << setw (12) << "peak KB"
+       << setw (12) << "max table" << setw (12) << "max live"
+       << setw (12) << "defined" << endl;
+  bool first = true;
+  for (int i = optind; i < argc; i++)
+    for (int m = -1; m <= int (thresholds.size () + strategies.size ()); m++)
+      {
+	// m = -1: Felsch; m = 0: HLT; then HLT+ with each threshold,
+	// then each hybrid strategy.
+	const int nt = thresholds.size ();
+	const int threshold = (m > 0 && m <= nt) ? thresholds[m - 1] : 0;
+	const string spec = (m > nt) ? strategies[m - nt - 1] : "";
+	Strategy strategy;
+	parse_strategy (spec, strategy);
+	const int meth = (m < 0 ? int (CosetTableBase::FELSCH)
+			  : m > nt ? int (CosetTableBase::HYBRID) : threshold);
+	string method = (m < 0 ? "felsch" : m == 0 ? "hlt"
+			 : m > nt ? "hybrid" : "hlt+");
+	Result r;
+	run_one (argv[i], meth, strategy, nthreads, r);
+	const string name = example_name (argv[i]);
+	ostringstream label;
+	label << method;
+	if (threshold > 0)
+	  label << " " << threshold;
+	if (!spec.empty ())
+	  label << " " << spec;
+	cout << left << setw (10) << name << setw (16) << label.str ()
+	     << right;
+	if (r.ok)
+	  cout << setw (10) << fixed << setprecision (3) << r.seconds
+	       << setw (12) << r.rss_kb << setw (12) << r.max_rows
+	       << setw (12) << r.max_live << setw (12) << r.defined << endl;
+	else
+	  cout << setw (10) << "failed" << setw (12) << r.rss_kb << endl;
+	out << (first ? "\n" : ",\n")
+	    << "    {\"example\": \"" << name << "\", "
+	    << "\"method\": \"" << method << "\", "
+	    << "\"threshold\": " << threshold << ", "
+	    << "\"strategy\": \"" << spec << "\", "
+	    << "\"status\": \"" << (r.ok ? "ok" : "failed") << "\", "
+	    << "\"peak_rss_kb\": " << r.rss_kb;
+	if (r.ok)
+	  out << ", \"index\": " << r.index
+	      << ", \"wall_seconds\": " << fixed << setprecision (6)
+	      << r.seconds
+	      << ", \"max_table_size\": " << r.max_rows
+	      << ", \"max_live_cosets\": " << r.max_live
+	      << ", \"cosets_defined\": " << r.defined;
+	out << "}";
+	first = false;
+      }
+  out << "\n  ]\n}\n";
+  cout << "\nResults written to " << outfile << ".\n";
+}
+
+// Enumerate in a child process and collect the results.  Return true
+// on success; on failure (e.g., threshold too small or memory
+// exhausted) r.ok is false.
+bool
+run_one (const string& file, int method, const Strategy& strategy,
+	 int nthreads, Result& r)
+{
+  r.ok = false;
+  r.rss_kb = 0;
+  int fd[2];
+  if (pipe (fd) != 0)
+    return false;
+  cout.flush ();
+  pid_t pid = fork ();
+  if (pid < 0)
+    return false;
+  if (pid == 0)
+    {
+      // Child: silence the engine's progress messages.
+      close (fd[0]);
+      if (!freopen ("/dev/null", "w", stdout)
+	  || !freopen ("/dev/null", "w", stderr))
+	_exit (2);
+      istream* input = new ifstream (file.c_str ());
+      if (!*input)
+	_exit (2);
+      TC* tcp;
+      if (method == CosetTableBase::HYBRID)
+	tcp = new TC (input, strategy);
+      else
+	tcp = new TC (input, method == CosetTableBase::FELSCH,
+		      method > 0 ? method : 0);
+      TC& tc = *tcp;
+      tc.set_threads (nthreads);
+      struct timeval start, stop;
+      gettimeofday (&start, 0);
+      try
+	{
+	  tc.enumerate ();
+	}
+      catch (CosetTableBase::Enumeration_Failed&)
+	{
+	  _exit (1);
+	}
+      gettimeofday (&stop, 0);
+      const double seconds = (stop.tv_sec - start.tv_sec)
+	+ (stop.tv_usec - start.tv_usec) / 1e6;
+      char buf[256];
+      const EnumStats s = tc.stats ();
+      int n = snprintf (buf, sizeof buf, "%ld %ld %ld %lu %.6f\n",
+			tc.index (), s.max_rows, s.max_live, s.defined,
+			seconds);
+      if (write (fd[1], buf, n) != n)
+	_exit (2);
+      _exit (0);
+    }
+  close (fd[1]);
+  string reply;
+  char buf[256];
+  ssize_t n;
+  while ((n = read (fd[0], buf, sizeof buf)) > 0)
+    reply.append (buf, n);
+  close (fd[0]);
+  int status;
+  struct rusage ru;
+  if (wait4 (pid, &status, 0, &ru) != pid)
+    return false;
+  r.rss_kb = ru.ru_maxrss;
+  istringstream is (reply);
+  r.ok = (WIFEXITED (status) && WEXITSTATUS (status) == 0
+	  && (is >> r.index >> r.max_rows >> r.max_live >> r.defined
+	      >> r.seconds));
+  return r.ok;
+}
+
+// examples/M12.in -> M12
+string
+example_name (const string& file)
+{
+  size_t slash = file.find_last_of ('/');
+  string name = (slash == string::npos) ? file : file.substr (slash + 1);
+  size_t dot = name.find_last_of ('.');
+  return (dot == string::npos) ? name : name.substr (0, dot);
+}
+
+void
+parse_args (int argc, char *argv[], string& outfile,
+	    vector<int>& thresholds, vector<string>& strategies,
+	    int& nthreads)
+{
+  const struct option long_options[] =
+    {
+      {"output",     required_argument, NULL, 'o'},
+      {"thresholds", required_argument, NULL, 't'},
+      {"threads",    required_argument, NULL, 'j'},
+      {"hybrid",     required_argument, NULL, 'y'},
+      {"help",	     no_argument,       NULL, 'h'},
+      {NULL,	     no_argument,       NULL,  0 }
+    };
+
+  const char *short_options = "o:t:j:y:h";
+
+  int opt;
+  while ((opt = getopt_long (argc, argv, short_options, long_options, NULL))
+	 != -1)
+    {
+      switch (opt)
+	{
+	case 'o':
+	  outfile = optarg;
+	  break;
+	case 't':
+	  {
+	    istringstream is (optarg);
+	    int t;
+	    char comma;
+	    while (is >> t)
+	      {
+		if (t <= 0)
+		  {
+		    usage ();
+		    exit (1);
+		  }
+		thresholds.push_back (t);
+		is >> comma;
+	      }
+	  }
+	  break;
+	case 'j':
+	  if ((nthreads = atoi (optarg)) <= 0)
+	    {
+	      usage ();
+	      exit (1);
+	    }
+	  break;
+	case 'y':
+	  {
+	    Strategy s;
+	    if (!parse_strategy (optarg, s))
+	      {
+		usage ();
+		exit (1);
+	      }
+	    strategies.push_back (optarg);
+	  }
+	  break;
+	default:
+	  usage ();
+	  exit (1);
+	  break;
+	}
+    }
+  if (optind == argc)
+    {
+      usage ();
+      exit (1);
+    }
+}
+
+void
+usage ()
+{
+  cerr << "\
+Usage: " << progname << " [-o OUTFILE] [-t THRESHOLD,...] [-y H,F[,L]]... \
+[-j THREADS] FILE...\n\n\
+Run HLT, HLT+lookahead (at each THRESHOLD; default 20000,200000,\n\
+2000000), Felsch and each hybrid strategy H,F[,L] (see toddcox -y) on\n\
+each input FILE, and write the wall time, peak memory, maximum table\n\
+size, maximum number of live cosets and number of cosets defined to\n\
+OUTFILE (default bench-results.json) in JSON format.\n";
+}
@@ -20,89 +20,164 @@
    Written by Ken Brown <kbrown@cornell.edu>. */
 
 #include <iostream>
+#include <fstream>
 #include <iomanip>
+#include <sstream>
 #include <set>
 #include <exception>
 #include <stdexcept>
 #include <algorithm>
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <stdint.h>
 
 #include "cosettable.h"
 #include "gens_and_words.h"
+#include "alphabet.h"
 #include "stack.h"
 #include "equivreln.h"
+#include "table.h"
+#include "relindex.h"
+#include "workerpool.h"
+#include "kernels.h"
 
 using namespace std;
 
+// HLT processes the rows of the table in order; if the table is kept
+// in a file, ask for this many rows at a time to be read in ahead.
+static const int READAHEAD = 1 << 14;
+
+// HLT prescans this many cosets at a time.  find_closed and
+// interleaved_scans follow SCAN_LANES scans at once; the latter
+// retires them from a window of SCAN_WINDOW (a power of 2).
+static const int PRESCAN_BLOCK = 1 << 13;
+static const int SCAN_LANES = 8;
+static const int SCAN_WINDOW = 64;
+
+// Interleaving only pays once the table is well beyond the last-level
+// cache; below this many bytes of entries, single scans are faster.
+static const long INTERLEAVE_BYTES = 1L << 30;
+
+// With threads, HLT processes blocks of up to PARALLEL_BLOCK cosets at
+// a time, in tasks of PARALLEL_TASK cosets each; see parallel_step.
+static const int PARALLEL_BLOCK = 1 << 12;
+static const int PARALLEL_TASK = 1 << 9;
+
+// Parallel lookahead works on tasks of this many cosets, and repeats
+// its pass over the table at most LOOKAHEAD_ROUNDS times.
+static const int LOOKAHEAD_TASK = 1 << 12;
+static const int LOOKAHEAD_ROUNDS = 3;
+
 // Constructor
-CosetTable::CosetTable (int NG, vector<string> rel, vector<string> gen_H,
-			bool felsch) : NGENS (NG), p (EquivReln (1))
+template <class T, int N>
+CosetTable<T, N>::CosetTable (const Alphabet& A, vector<string> rel,
+			   vector<string> gen_H, bool felsch, long maxcosets)
+  : alphabet (A), NGENS (A.size ()), memory_limit (0), step_rows (NGENS),
+    phase_pos (0), next_lookahead (0), method (0), rel_strings (rel),
+    gen_H_strings (gen_H), verbose (true),
+    checkpoint_interval (0), next_checkpoint (0), nticks (0),
+    resume_offset (0), resume_at (-1), tab (NGENS), p (EquivReln<T> (1)),
+    free_rows (-1), nfree (0), reuse_rows (false), cursor (0),
+    skip (1, false), pool (0), declined (0), renumbering (false),
+    pre_first (0), pre_last (0), gap_fill (false), deduction_stack (NGENS)
 {
-  row r (NGENS, -1);
-  tab.push_back (r);
+  // Coset numbers must fit in T.
+  MAXCOSETS = numeric_limits<T>::max ();
+  if (maxcosets > 0 && maxcosets < MAXCOSETS)
+    {
+      MAXCOSETS = maxcosets;
+      reuse_rows = true;
+    }
+  tab.set_max_rows (MAXCOSETS);
+  tab.add_row ();
+  stats.live = stats.max_live = stats.max_rows = 1;	// coset 0
+  // Caller should check that strings are valid.
   for (int i = 0; i < gen_H.size (); i++)
     {
       word w;
-      // Caller should check that strings are valid.
-      string_to_word (w, gen_H[i], NGENS);
+      alphabet.string_to_word (w, gen_H[i]);
       generator_of_H.push_back (w);
     }
-  vector<string> R;
   for (int i = 0; i < rel.size (); i++)
     {
       word w;
-      string s = rel[i];
-      string_to_word (w, s, NGENS);
+      alphabet.string_to_word (w, rel[i]);
       relator.push_back (w);
-      if (felsch)
-	{
-	  generator_of_H.push_back (w);
-	  // Accumulate s, s^{-1}, and all cyclic conjugates
-	  string sinv;
-	  transform (s.rbegin (), s.rend (), back_inserter (sinv), switch_case);
-	  for (int i = 0; i < s.size (); i++)
-	    {
-	      R.push_back (s);
-	      R.push_back (sinv);
-	      rotate (s);
-	      rotate (sinv);
-	    }
-	}
     }
-  // Group elements of R according to first letter after removing duplicates.
-  if (felsch)
+  simplify_presentation (relator, generator_of_H);
+  for (size_t i = 0; i < relator.size (); i++)
     {
-      typedef vector<string>::const_iterator VI;
-      VI itu = unique (R.begin (), R.end ());
-      for (VI it = R.begin (); it != itu; it++)
-	{
-	  word w;
-	  string_to_word (w, *it, NGENS);
-	  relator_grouped[w[0]].push_back (w);
-	}
+      step_rows += relator[i].size (); // An HLT step scans each relator.
+      if (felsch)
+	generator_of_H.push_back (relator[i]);
     }
+  if (felsch)
+    build_conjugates ();
 }
 
-// Define coset k acted on by x to be new coset; exit if can't
-// allocate memory.
+// Set up conjugates for Felsch.
+template <class T, int N>
 void
-CosetTable::define (coset k, gen x, bool save)
+CosetTable<T, N>::build_conjugates ()
 {
-  const int l = tab.size ();	// index of new coset
-  tab[k][x] = l;
-  row r (NGENS, -1);
-  r[inv (x)] = k;
-  try
+  vector<word> W;
+  set<word> seen;
+  for (size_t i = 0; i < relator.size (); i++)
     {
-      tab.push_back (r);
-      p.add ();		// p(l) = l
+      // Accumulate w, w^{-1}, and all their cyclic conjugates,
+      // skipping repeats (which occur when w is a proper power or
+      // conjugate to its inverse).
+      const word& w = relator[i];
+      word r[2] = { w, inverse (w) };
+      for (size_t j = 0; j < w.size (); j++)
+	for (int e = 0; e < 2; e++)
+	  {
+	    if (seen.insert (r[e]).second)
+	      W.push_back (r[e]);
+	    std::rotate (r[e].begin (), r[e].begin () + 1, r[e].end ());
+	  }
     }
-  catch (bad_alloc)
+  // Group the conjugates according to first letter.
+  conjugates.build (NGENS, W);
+}
+
+// Define coset k acted on by x to be new coset; throw
+// Enumeration_Failed if we can't allocate memory or the table has
+// reached its maximum size.  The row of a dead coset is reused if
+// there is one and rows are short: the table has reached MAXCOSETS,
+// or its size is limited (reuse_rows).  Otherwise the table grows,
+// since the reused rows are scattered, and HLT runs much slower on
+// them.
+template <class T, int N>
+void
+CosetTable<T, N>::define (coset k, gen x, bool save)
+{
+  coset l;			// index of new coset
+  if (free_rows >= 0 && (reuse_rows || tab.size () >= MAXCOSETS))
     {
-      cerr << "\n\nCoset table has size " << tab.size ()
-	   << "; memory exhausted.\n";
-      exit (EXIT_FAILURE);
+      l = free_rows;
+      free_rows = tab (l, 0);
+      nfree--;
+      tab.clear_row (l);
+      p.reset (l);
+      // The new coset still has to be processed, after all those
+      // that exist now; see next_to_process.
+      revisit.push_back (make_pair (l, coset (tab.size ())));
+      skip[l] = (l >= cursor);
+      // Forget what prescan found out about the old coset l.
+      if (l >= pre_first && l < pre_last)
+	fill_n (closed.begin () + (l - pre_first) * relator.size (),
+		relator.size (), 0);
     }
+  else
+    l = add_coset ();
+  tab (k, x) = l;
+  tab (l, inv (x)) = k;
+  stats.defined++;
+  if (++stats.live > stats.max_live)
+    stats.max_live = stats.live;
   if (save)
     {
       deduction ded = {k, x};
@@ -110,26 +185,122 @@ CosetTable::define (coset k, gen x, bool save)
     }
 }
 
+// Add a new coset in a new row at the end of the table, and return
+// it; throw Enumeration_Failed as for define.
+template <class T, int N>
+typename CosetTable<T, N>::coset
+CosetTable<T, N>::add_coset ()
+{
+  coset l;
+  if (tab.size () >= MAXCOSETS)
+    {
+      ostringstream os;
+      os << "Coset table has size " << tab.size ()
+	 << "; maximum number of cosets reached";
+      if (memory_limit > 0)
+	os << " (memory limit " << memory_limit << " bytes)";
+      os << ".";
+      throw Enumeration_Failed (os.str ());
+    }
+  try
+    {
+      l = tab.add_row ();
+      p.add ();			// p(l) = l
+      skip.push_back (false);
+    }
+  catch (bad_alloc&)
+    {
+      // Undo whatever succeeded, so that the table is still usable.
+      const long n = min (min (tab.size (), p.size ()), long (skip.size ()));
+      tab.truncate (n);
+      p.truncate (n);
+      skip.resize (n);
+      ostringstream os;
+      os << "Coset table has size " << tab.size ()
+	 << "; memory exhausted.";
+      throw Enumeration_Failed (os.str ());
+    }
+  if (tab.size () > stats.max_rows)
+    stats.max_rows = tab.size ();
+  return l;
+}
+
 // Use standard numbering for coset tables, starting with 1 instead of 0.
-ostream&
-operator<< (ostream& os, const CosetTable::row& r)
+template <class T>
+static void
+print_row (ostream& os, const T* r, int n, int width)
 {
-  os << setw (4) << r[0] + 1;
-  for (CosetTable::gen x = 1; x < r.size (); x++)
-    os << " " << setw (3) << r[x] + 1;
-  return os;
+  os << setw (width) << r[0] + 1;
+  for (int x = 1; x < n; x++)
+    os << " " << setw (width - 1) << r[x] + 1;
 }
 
-ostream&
-operator<< (ostream& os, const CosetTable& C)
+// Columns are 4 characters wide, or wider if some generator has a
+// long name.
+template <class T, int N>
+void
+CosetTable<T, N>::print (ostream& os) const
 {
+  int width = 4;
+  for (gen x = 0; x < NGENS; x++)
+    width = max (width, int (alphabet.name (x).size ()) + 1);
   os << "    ";
-  for (CosetTable::gen x = 0; x < C.NGENS; x++)
-    os << setw (4) << gens[x];
+  for (gen x = 0; x < NGENS; x++)
+    os << setw (width) << alphabet.name (x);
   os << endl;
-  for (CosetTable::coset k = 0; k < C.tab.size (); k++)
-    if (C.isalive (k))
-	os << setw (2) << k + 1 << ": " << C.tab[k] << endl;
+  for (coset k = 0; k < tab.size (); k++)
+    if (isalive (k))
+      {
+	os << setw (2) << k + 1 << ": ";
+	print_row (os, tab.row (k), NGENS, width);
+	os << endl;
+      }
+}
+
+// Append the n low-order bytes of v to buf, least significant first.
+static void
+put_le (vector<char>& buf, uint64_t v, int n)
+{
+  for (int i = 0; i < n; i++, v >>= 8)
+    buf.push_back (char (v & 0xff));
+}
+
+// See cosettable.h for the format.  The table must be compressed.
+template <class T, int N>
+bool
+CosetTable<T, N>::write_binary (ostream& os) const
+{
+  const long n = tab.size ();
+  const int width = (n <= numeric_limits<int32_t>::max () ? 4 : 8);
+  vector<char> buf;
+  const char magic[8] = "TCTABLE";
+  buf.insert (buf.end (), magic, magic + sizeof magic);
+  put_le (buf, 1, 4);
+  put_le (buf, width, 4);
+  put_le (buf, n, 8);
+  put_le (buf, NGENS, 4);
+  put_le (buf, 0, 4);
+  const long rows_per_write = (1 << 16) / NGENS + 1;
+  for (coset k = 0; k < n && os; k++)
+    {
+      const T* r = tab.row (k);
+      for (gen x = 0; x < NGENS; x++)
+	put_le (buf, r[x], width);
+      if ((k + 1) % rows_per_write == 0 || k == n - 1)
+	{
+	  os.write (&buf[0], buf.size ());
+	  buf.clear ();
+	}
+    }
+  if (n == 0)
+    os.write (&buf[0], buf.size ());
+  return bool (os.flush ());
+}
+
+ostream&
+operator<< (ostream& os, const CosetTableBase& C)
+{
+  C.print (os);
   return os;
 }
 
@@ -139,7 +310,7 @@ CosetTable::debug_print () const
 {
   cout << "       ";
   for (gen x = 0; x < NGENS; x++)
-    cout << setw (4) << gens[x];
+    cout << setw (4) << alphabet.name (x);
   cout << endl;
    for (CosetTable::coset k = 0; k < tab.size (); k++)
     {
@@ -151,33 +322,37 @@ CosetTable::debug_print () const
 }
 #endif
 
+template <class T, int N>
 void
-CosetTable::coincidence (coset k, coset l, bool save)
+CosetTable<T, N>::coincidence (coset k, coset l, bool save)
 {
+  unsigned long nkilled = 0;
+  stats.coincidences++;
   merge (k, l);
   while (!q.empty ())
     {
       coset e = q.front ();
       q.pop ();
+      nkilled++;
       // Transfer all info about e
       for (gen x = 0; x < NGENS; x++)
 	{
 	  if (!isdefined (e, x))
 	    continue;
 	  gen y = inv (x);
-	  coset f = tab[e][x];	// x: e --> f, y: f --> e
+	  coset f = tab (e, x);	// x: e --> f, y: f --> e
 	  undefine (f, y);	// remove arrow f --> e
 	  coset e1 = p.rep (e);
 	  coset f1 = p.rep (f);
 	  // insert arrows x: e1 --> f1 and y: f1 --> e1
 	  if (isdefined (e1, x))
-	    merge (f1, tab[e1][x]);
+	    merge (f1, tab (e1, x));
 	  else if (isdefined (f1, y))
-	    merge (e1, tab[f1][y]);
+	    merge (e1, tab (f1, y));
 	  else
 	    {
-	      tab[e1][x] = f1;
-	      tab[f1][y] = e1;
+	      tab (e1, x) = f1;
+	      tab (f1, y) = e1;
 	      if (save)
 		{
 		  deduction ded = {e1, x};
@@ -185,11 +360,68 @@ CosetTable::coincidence (coset k, coset l, bool save)
 		}
 	    }
 	}
+      // Nothing refers to e any more, so its row can be reused.
+      // Link it into the free list through its first entry.
+      tab (e, 0) = free_rows;
+      free_rows = e;
+      nfree++;
+    }
+  stats.killed += nkilled;
+  stats.live -= nkilled;
+  if (nkilled > stats.max_cascade)
+    stats.max_cascade = nkilled;
+}
+
+// Return the next live coset to be processed by HLT or Felsch, or -1
+// if there are none left.  Cosets are normally processed in row
+// order, and cursor is the next row.  But a coset whose row was
+// reused from the free list is out of place: its row may even lie
+// behind the cursor.  So define puts it on the revisit queue, along
+// with the table size at the time, and it is processed once the
+// cursor reaches that size.  If the row lies ahead of the cursor,
+// define also puts it in skip, so that the cursor passes over it.
+// In this way cosets are still processed in the order in which they
+// were defined, which matters for HLT: processing reused rows early
+// makes the table grow noticeably larger.
+template <class T, int N>
+typename CosetTable<T, N>::coset
+CosetTable<T, N>::next_to_process ()
+{
+  if (resume_at >= 0)
+    {
+      coset k = resume_at;
+      resume_at = -1;
+      return k;
+    }
+  for (;;)
+    {
+      coset k;
+      if (!revisit.empty () && revisit.front ().second <= cursor)
+	{
+	  k = revisit.front ().first;
+	  revisit.pop_front ();
+	}
+      else if (cursor < tab.size ())
+	{
+	  k = cursor++;
+	  if (skip[k])
+	    {
+	      skip[k] = false;
+	      continue;
+	    }
+	  if (k % READAHEAD == 0)
+	    tab.willneed (k, READAHEAD);
+	}
+      else
+	return -1;
+      if (isalive (k))
+	return k;
     }
 }
 
+template <class T, int N>
 void
-CosetTable::scan_and_fill (coset k, const word& w, bool save)
+CosetTable<T, N>::scan_and_fill (coset k, const word& w, bool save)
 {
   int i = 0, j = w.size () - 1;	// Starting pos for forward and backward scans
   coset f = k, b = k;		// Starting cosets for scans
@@ -197,7 +429,7 @@ CosetTable::scan_and_fill (coset k, const word& w, bool save)
     {
       // Scan forward
       while (i <= j && isdefined (f, w[i]))
-	f = tab[f][w[i++]];
+	f = tab (f, w[i++]);
       if (i > j)		// Scan completed, possibly with coincidence
 	{
 	  if (f != b)
@@ -206,7 +438,7 @@ CosetTable::scan_and_fill (coset k, const word& w, bool save)
 	}
       // Scan backward
       while (j >= i && isdefined (b, inv (w[j])))
-	b = tab[b][inv (w[j--])];
+	b = tab (b, inv (w[j--]));
       if (j < i)		// Scan completed with coincidence
 	{
 	  coincidence (f, b, save);
@@ -214,8 +446,9 @@ CosetTable::scan_and_fill (coset k, const word& w, bool save)
 	}
       if (j == i)		// Scan completed with deduction
 	{
-	  tab[f][w[i]] = b;
-	  tab[b][inv (w[i])] = f;
+	  tab (f, w[i]) = b;
+	  tab (b, inv (w[i])) = f;
+	  stats.deductions++;
 	  if (save)
 	    {
 	      deduction d = {f, w[i]};
@@ -228,14 +461,15 @@ CosetTable::scan_and_fill (coset k, const word& w, bool save)
     }
 }
 
+template <class T, int N>
 void
-CosetTable::scan (coset k, const word& w, bool save)
+CosetTable<T, N>::scan (coset k, const gen* w, int n, bool save)
 {
-  int i = 0, j = w.size () - 1;	// Starting pos for forward and backward scans
+  int i = 0, j = n - 1;	// Starting pos for forward and backward scans
   coset f = k, b = k;		// Starting cosets for scans
   // Scan forward
   while (i <= j && isdefined (f, w[i]))
-    f = tab[f][w[i++]];
+    f = tab (f, w[i++]);
   if (i > j)		// Scan completed, possibly with coincidence
     {
       if (f != b)
@@ -244,29 +478,44 @@ CosetTable::scan (coset k, const word& w, bool save)
     }
   // Scan backward
   while (j >= i && isdefined (b, inv (w[j])))
-    b = tab[b][inv (w[j--])];
+    b = tab (b, inv (w[j--]));
   if (j < i)		// Scan completed with coincidence
     coincidence (f, b, save);
   else if (j == i)		// Scan completed with deduction
     {
-      tab[f][w[i]] = b;
-      tab[b][inv (w[i])] = f;
+      tab (f, w[i]) = b;
+      tab (b, inv (w[i])) = f;
+      stats.deductions++;
       if (save)
 	{
 	  deduction d = {f, w[i]};
 	  deduction_stack.push (d);
 	}
     }
+  else if (j == i + 1 && save && gap_fill)
+    {
+      // Scan is incomplete, but defining f^w[i] would complete it
+      // with a deduction.
+      if (preferred.size () >= PDL_SIZE)
+	preferred.pop_front ();
+      preferred.push_back (make_pair (f, w[i]));
+    }
   // else scan is incomplete and yields no information
 }
 
+template <class T, int N>
 void
-CosetTable::enumerate (int method)
+CosetTable<T, N>::enumerate (int method)
 {
+  this->method = method;
+  if (!resume_file.empty ())
+    restore ();
   if (method == 0)
     hlt ();
-  else if (method < 0)
+  else if (method == FELSCH)
     felsch ();
+  else if (method == HYBRID)
+    hybrid ();
   else
     {
       try
@@ -275,36 +524,358 @@ CosetTable::enumerate (int method)
 	}
       catch (Threshold_Exceeded)
 	{
-	  cerr << "\nSorry, can't recover enough memory.\n"
-	       << "Please try again with a bigger threshold.\n";
-	  exit (EXIT_FAILURE);
+	  throw Enumeration_Failed ("Sorry, can't recover enough memory.\n"
+				    "Please try again with a bigger "
+				    "threshold.");
 	}
     }
 }
 
 // HLT algorithm
+template <class T, int N>
 void
-CosetTable::hlt ()
+CosetTable<T, N>::hlt ()
 {
-  for (int i = 0; i < generator_of_H.size (); i++)
-    scan_and_fill (0, generator_of_H[i]);
-  // Must recompute tab.size() after each iteration.  Note that an
-  // iterator wouldn't work well here because elements keep getting
-  // added to tab.
-  for (coset k = 0; k < tab.size (); k++)
+  if (resume_at < 0)		// unless carrying on from a checkpoint
+    for (size_t i = 0; i < generator_of_H.size (); i++)
+      scan_and_fill (0, generator_of_H[i]);
+  for (coset k; (k = next_to_process ()) >= 0; )
     {
-      for (int i = 0; i < relator.size () && isalive (k); i++)
-	scan_and_fill (k, relator[i]);
-      if (isalive (k))
-	for (gen x = 0; x < NGENS; x++)
-	  if (!isdefined (k, x))
-	    define (k, x);
+      tick (k);
+      if ((k = make_room (k)) < 0)
+	return;
+      if (method == FELSCH)
+	{
+	  resume_at = k;
+	  felsch ();
+	  return;
+	}
+      if (pool && k == cursor - 1 && parallel_step (k, MAXCOSETS))
+	continue;
+      hlt_step (k);
+    }
+}
+
+// Process coset k as in HLT: scan every relator at k, making
+// definitions as needed, and then fill in the rest of row k.
+template <class T, int N>
+void
+CosetTable<T, N>::hlt_step (coset k, bool save)
+{
+  if (interleaving () && k >= pre_last)
+    prescan (k);
+  const int nrel = relator.size ();
+  const char* c = 0;
+  if (k >= pre_first && k < pre_last)
+    c = closed.data () + (k - pre_first) * nrel;
+  for (int i = 0; i < nrel && isalive (k); i++)
+    if (!c || !c[i])
+      scan_and_fill (k, relator[i], save);
+  if (isalive (k))
+    for (gen x = 0; x < NGENS; x++)
+      if (!isdefined (k, x))
+	define (k, x, save);
+}
+
+// With threads, HLT processes a whole block of cosets at a time,
+// starting at k, the coset just taken from the cursor.  The block is
+// split into tasks, and each worker carries out the HLT steps for its
+// task with process_block, against the table as it stood at the start
+// of the block.  Nothing changes the table while the workers run.
+// Their results are then applied in order of task, so the table is
+// the same for any number of threads, though not the same as without
+// threads: a step doesn't see what the steps in other tasks of the
+// same block defined, so the table grows somewhat larger.  Return
+// false, having changed nothing, if the block would be too small to
+// be worth it, or if it would take the table size beyond limit (or
+// MAXCOSETS); the caller then carries on with hlt_step, and the rest
+// of a block that was given up on is not tried again.
+template <class T, int N>
+bool
+CosetTable<T, N>::parallel_step (coset k, long limit)
+{
+  const coset last = min (long (k) + PARALLEL_BLOCK, tab.size ());
+  if (k < declined || last - k < 2 * PARALLEL_TASK)
+    return false;
+  const int ntasks = (last - k + PARALLEL_TASK - 1) / PARALLEL_TASK;
+  vector<Delta> d (ntasks);
+  pool->run (ntasks, [&] (int t)
+    {
+      const coset first = k + t * PARALLEL_TASK;
+      process_block (first, min (long (first) + PARALLEL_TASK, long (last)),
+		     d[t]);
+    });
+  long added = 0;
+  for (int t = 0; t < ntasks; t++)
+    added += d[t].rows.size () / NGENS + d[t].redo.size () * step_rows;
+  if (tab.size () + added > min (limit, MAXCOSETS))
+    {
+      declined = last;
+      return false;
+    }
+  // The cursor passes over the block; cosets in it that are due for a
+  // revisit were left to that.
+  for (coset l = k + 1; l < last; l++)
+    skip[l] = false;
+  cursor = last;
+  for (int t = 0; t < ntasks; t++)
+    apply (d[t]);
+  pre_first = pre_last = 0;
+  for (int t = 0; t < ntasks; t++)
+    for (size_t i = 0; i < d[t].redo.size (); i++)
+      if (isalive (d[t].redo[i]))
+	hlt_step (d[t].redo[i]);
+  return true;
+}
+
+// Carry out the HLT steps for the live cosets from first to last,
+// without changing the table, and record the outcome in d.  New
+// cosets are numbered -2, -3, ..., and their entries are kept in
+// d.rows; new entries for existing cosets are kept in d.entries.  A
+// scan that completes with a coincidence is recorded in
+// d.coincidences, and is not followed up.  The step for that coset
+// stops there, as it would if the coset died, and is put in d.redo:
+// parallel_step finishes it once the coincidence has been processed.
+// Carrying on would mostly define new cosets that are not needed.
+template <class T, int N>
+void
+CosetTable<T, N>::process_block (coset first, coset last, Delta& d) const
+{
+  d.deductions = 0;
+  // The entry for c acted on by x, or -1 if there is none.
+  auto get = [&] (long c, gen x) -> long
+    {
+      if (c < 0)
+	return d.rows[(-2 - c) * NGENS + x];
+      if (isdefined (c, x))
+	return tab (c, x);
+      auto e = d.entries.find (c * NGENS + x);
+      return e == d.entries.end () ? -1 : e->second;
+    };
+  auto set = [&] (long c, gen x, long v)
+    {
+      if (c < 0)
+	d.rows[(-2 - c) * NGENS + x] = v;
+      else
+	{
+	  d.entries[c * NGENS + x] = v;
+	  d.keys.push_back (c * NGENS + x);
+	}
+    };
+  auto define = [&] (long c, gen x)
+    {
+      const long l = -2 - long (d.rows.size () / NGENS);
+      d.rows.resize (d.rows.size () + NGENS, -1);
+      set (c, x, l);
+      set (l, inv (x), c);
+    };
+  for (coset k = first; k < last; k++)
+    {
+      if (!isalive (k) || skip[k])
+	continue;
+      const size_t ncoinc = d.coincidences.size ();
+      for (size_t r = 0;
+	   r < relator.size () && d.coincidences.size () == ncoinc; r++)
+	{
+	  const word& w = relator[r];
+	  int i = 0, j = w.size () - 1;
+	  long f = k, b = k, g;
+	  for (;;)
+	    {
+	      while (i <= j && (g = get (f, w[i])) != -1)
+		f = g, i++;
+	      if (i > j)
+		{
+		  if (f != b)
+		    d.coincidences.push_back (make_pair (f, b));
+		  break;
+		}
+	      while (j >= i && (g = get (b, inv (w[j]))) != -1)
+		b = g, j--;
+	      if (j < i)
+		{
+		  d.coincidences.push_back (make_pair (f, b));
+		  break;
+		}
+	      if (j == i)
+		{
+		  set (f, w[i], b);
+		  set (b, inv (w[i]), f);
+		  d.deductions++;
+		  break;
+		}
+	      define (f, w[i]);
+	    }
+	}
+      if (d.coincidences.size () > ncoinc)
+	{
+	  d.redo.push_back (k);
+	  continue;
+	}
+      for (gen x = 0; x < NGENS; x++)
+	if (get (k, x) == -1)
+	  define (k, x);
+    }
+}
+
+// Apply the outcome of process_block to the table.  The new cosets
+// get new rows at the end of the table; rows of dead cosets are not
+// reused, since d may still refer to the cosets that died in applying
+// an earlier task.  An entry that conflicts with the table gives a
+// coincidence.
+template <class T, int N>
+void
+CosetTable<T, N>::apply (const Delta& d)
+{
+  const long n = d.rows.size () / NGENS;
+  vector<coset> row (n);
+  for (long j = 0; j < n; j++)
+    {
+      row[j] = add_coset ();
+      stats.defined++;
+      if (++stats.live > stats.max_live)
+	stats.max_live = stats.live;
+    }
+  auto rep = [&] (long c) { return p.rep (c >= 0 ? coset (c) : row[-2 - c]); };
+  auto join = [&] (long c, gen x, long v)
+    {
+      const coset e = rep (c), f = rep (v);
+      if (isdefined (e, x))
+	{
+	  if (tab (e, x) != f)
+	    coincidence (tab (e, x), f);
+	}
+      else if (isdefined (f, inv (x)))
+	coincidence (e, tab (f, inv (x)));
+      else
+	{
+	  tab (e, x) = f;
+	  tab (f, inv (x)) = e;
+	}
+    };
+  for (long j = 0; j < n; j++)
+    for (gen x = 0; x < NGENS; x++)
+      if (d.rows[j * NGENS + x] != -1)
+	join (-2 - j, x, d.rows[j * NGENS + x]);
+  for (size_t i = 0; i < d.keys.size (); i++)
+    join (d.keys[i] / NGENS, d.keys[i] % NGENS, d.entries.at (d.keys[i]));
+  for (size_t i = 0; i < d.coincidences.size (); i++)
+    {
+      const coset e = rep (d.coincidences[i].first);
+      const coset f = rep (d.coincidences[i].second);
+      if (e != f)
+	coincidence (e, f);
     }
+  stats.deductions += d.deductions;
+}
+
+// Is the table big enough for HLT to prescan, and for lookahead to
+// interleave its scans?
+template <class T, int N>
+bool
+CosetTable<T, N>::interleaving () const
+{
+  return tab.size () * NGENS * long (sizeof (T)) >= INTERLEAVE_BYTES;
+}
+
+// Scan the relators at the next block of cosets, starting at k, and
+// record which scans are already complete, i.e., which relators are
+// already known to hold at which cosets.  A complete scan stays
+// complete as the table grows and coincidences are processed, so
+// hlt_step can skip it: scan_and_fill would find nothing to do.  The
+// table is the same as without prescanning; the dependent loads of
+// the closed scans are just taken off the critical path by
+// overlapping them in find_closed.
+template <class T, int N>
+void
+CosetTable<T, N>::prescan (coset k)
+{
+  const int nrel = relator.size ();
+  pre_first = k;
+  pre_last = min (long (k) + PRESCAN_BLOCK, tab.size ());
+  closed.assign ((pre_last - pre_first) * nrel, 0);
+  find_closed (pre_first, pre_last, closed.data ());
+}
+
+// Following a relator through the table is a chain of dependent
+// loads, each of them likely to miss the cache once the table is
+// large.  So find_closed (like interleaved_scans) keeps SCAN_LANES
+// such scans going at once: the lanes take turns, each following its
+// relator by one letter and prefetching the entry it will read next,
+// so that the misses of different lanes overlap.  A lane that
+// finishes starts the next scan.  For each live coset c with first <=
+// c < last and each relator i, find_closed sets closed[(c - first) *
+// nrel + i] if the forward scan of relator i at c completes and
+// returns to c.  Only reads the table.
+template <class T, int N>
+void
+CosetTable<T, N>::find_closed (coset first, coset last, char* closed) const
+{
+  struct Lane
+  {
+    coset k, f;			// starting and current coset
+    const gen* w;
+    int len, pos;		// length of w, next letter to follow
+    char* result;
+  };
+  const int nrel = relator.size ();
+  coset c = first;		// The next scan to start is relator i at c.
+  int i = 0;
+  // Start the next scan in l; return false if there are none left.
+  auto start = [&] (Lane& l) -> bool
+    {
+      while (c < last && (i == nrel || !isalive (c)))
+	{
+	  c++;
+	  i = 0;
+	}
+      if (c == last)
+	return false;
+      l.k = l.f = c;
+      l.w = relator[i].data ();
+      l.len = relator[i].size ();
+      l.pos = 0;
+      l.result = closed + (c - first) * nrel + i;
+      i++;
+      return true;
+    };
+  Lane lane[SCAN_LANES];
+  int nlanes = 0;
+  while (nlanes < SCAN_LANES && start (lane[nlanes]))
+    nlanes++;
+  while (nlanes > 0)
+    for (int j = 0; j < nlanes; )
+      {
+	Lane& l = lane[j];
+	const coset g = tab (l.f, l.w[l.pos++]);
+	if (g >= 0 && l.pos < l.len)
+	  {
+	    l.f = g;
+	    tab.prefetch (g, l.w[l.pos]);
+	    j++;
+	    continue;
+	  }
+	*l.result = (g == l.k);
+	if (start (l))
+	  j++;
+	else
+	  l = lane[--nlanes];
+      }
+}
+
+template <class T, int N>
+void
+CosetTable<T, N>::set_threads (int n)
+{
+  delete pool;
+  pool = (n > 1) ? new WorkerPool (n) : 0;
+  pre_first = pre_last = 0;
 }
 
 // HLT algorithm with lookahead.
+template <class T, int N>
 void
-CosetTable::hlt_plus (int threshold)
+CosetTable<T, N>::hlt_plus (int threshold)
 {
 // Try to reserve space for a table of size threshold to avoid the
 // overhead of reallocation.
@@ -312,70 +883,171 @@ CosetTable::hlt_plus (int threshold)
     {
       tab.reserve (threshold);
     }
-  catch (bad_alloc)
+  catch (bad_alloc&)
     {
       ;	 // No harm if it fails; just means threshold will be useless.
     }
-  catch (length_error)
+  catch (length_error&)
     {
       ;				// ditto
     }
-  for (int i = 0; i < generator_of_H.size (); i++)
-    scan_and_fill (0, generator_of_H[i]);
-  for (coset k = 0; k < tab.size (); k++)
+  if (resume_at < 0)		// unless carrying on from a checkpoint
+    for (size_t i = 0; i < generator_of_H.size (); i++)
+      scan_and_fill (0, generator_of_H[i]);
+  for (coset k; (k = next_to_process ()) >= 0; )
     {
-      if (!isalive (k))
-	continue;
       if (tab.size () > threshold)
 	{
-	  const int n = tab.size ();
-	  cout << "\nThreshold exceeded; table size is "
-	       << n << ".  Looking ahead...\n";
+	  if (verbose)
+	    cout << "\nThreshold exceeded; table size is "
+		 << tab.size () << ".  Looking ahead...\n";
 	  lookahead (k);
 	  // Move to next live coset, in case k died
-	  while (k < n && !isalive (k))
-	    k++;
-	  if (k == n)
+	  if (!isalive (k) && (k = next_to_process ()) < 0)
 	    return;
-	  k = compress (k);
-	  cout << "Table size is now " << tab.size () << ".";
+	  k = renumbering ? localize (k) : compress (k);
+	  pre_first = pre_last = 0;	// Prescan is out of date
+	  if (verbose)
+	    cout << "Table size is now " << tab.size () << ".";
 	  if (tab.size () > threshold)
 	    throw Threshold_Exceeded ();
-	  cout << "  Continuing.\n";
+	  if (verbose)
+	    cout << "  Continuing.\n";
 	}
-      for (int i = 0; i < relator.size () && isalive (k); i++)
-	scan_and_fill (k, relator[i]);
-      if (isalive (k))
-	for (gen x = 0; x < NGENS; x++)
-	  if (!isdefined (k, x))
-	    define (k, x);
+      tick (k);
+      if ((k = make_room (k)) < 0)
+	return;
+      if (method == FELSCH)
+	{
+	  resume_at = k;
+	  felsch ();
+	  return;
+	}
+      if (pool && k == cursor - 1
+	  && parallel_step (k, long (threshold) + step_rows))
+	continue;
+      hlt_step (k);
     }
 }
 
 // Felsch algorithm
+template <class T, int N>
 void
-CosetTable::felsch ()
+CosetTable<T, N>::felsch ()
 {
-  for (int i = 0; i < generator_of_H.size (); i++)
-    scan_and_fill (0, generator_of_H[i], true);
+  if (resume_at < 0)		// unless carrying on from a checkpoint
+    for (size_t i = 0; i < generator_of_H.size (); i++)
+      scan_and_fill (0, generator_of_H[i], true);
   process_deductions ();
-  for (coset k = 0; k < tab.size (); k++)
+  for (coset k; (k = next_to_process ()) >= 0; )
     {
+      tick (k);
+      if ((k = make_room (k)) < 0)
+	return;
       for (gen x = 0; x < NGENS && isalive (k); x++)
 	if (!isdefined (k, x))
 	  {
-	    define (k, x, true);
-	    process_deductions ();
+	    if (gap_fill)
+	      fill_gap ();
+	    if (isalive (k) && !isdefined (k, x))
+	      {
+		define (k, x, true);
+		process_deductions ();
+	      }
 	  }
     }
 }
 
+// Gap filling, as described by Holt and used in ACE.  When a scan in
+// process_deductions stops one definition short of a deduction, the
+// entry that would have to be defined is put on the preferred
+// definition list, which holds the most recent PDL_SIZE such entries.
+// Before each definition in coset order, felsch calls fill_gap to
+// define the oldest of these entries that is still undefined.
+// Such definitions tend to close relator cycles at once and so make
+// fewer cosets in all.  Taking turns with the definitions in coset
+// order ensures that every coset is eventually processed.  The list
+// is only a heuristic, so it isn't saved in checkpoints.
+template <class T, int N>
+void
+CosetTable<T, N>::fill_gap ()
+{
+  while (!preferred.empty ())
+    {
+      const coset c = preferred.front ().first;
+      const gen x = preferred.front ().second;
+      preferred.pop_front ();
+      if (isalive (c) && !isdefined (c, x))
+	{
+	  stats.gap_fills++;
+	  define (c, x, true);
+	  process_deductions ();
+	  return;
+	}
+    }
+}
+
+// Hybrid of HLT and Felsch; see Strategy in cosettable.h.
+template <class T, int N>
 void
-CosetTable::process_deductions ()
+CosetTable<T, N>::hybrid ()
+{
+  const long cycle = strategy.hlt_cosets + strategy.felsch_cosets;
+  if (resume_at < 0)		// unless carrying on from a checkpoint
+    for (size_t i = 0; i < generator_of_H.size (); i++)
+      scan_and_fill (0, generator_of_H[i], true);
+  process_deductions ();
+  if (resume_at < 0)
+    next_lookahead = stats.defined + strategy.lookahead_every;
+  for (coset k; (k = next_to_process ()) >= 0; )
+    {
+      tick (k);
+      if ((k = make_room (k)) < 0)
+	return;
+      if (method == FELSCH)
+	{
+	  resume_at = k;
+	  felsch ();
+	  return;
+	}
+      if (strategy.lookahead_every > 0 && stats.defined >= next_lookahead)
+	{
+	  lookahead (0, true);
+	  process_deductions ();
+	  next_lookahead = stats.defined + strategy.lookahead_every;
+	  if (!isalive (k) && (k = next_to_process ()) < 0)
+	    return;
+	}
+      if (phase_pos < strategy.hlt_cosets)
+	{
+	  hlt_step (k, true);
+	  process_deductions ();
+	}
+      else
+	for (gen x = 0; x < NGENS && isalive (k); x++)
+	  if (!isdefined (k, x))
+	    {
+	      if (gap_fill)
+		fill_gap ();
+	      if (isalive (k) && !isdefined (k, x))
+		{
+		  define (k, x, true);
+		  process_deductions ();
+		}
+	    }
+      if (++phase_pos >= cycle)
+	phase_pos = 0;
+    }
+}
+
+template <class T, int N>
+void
+CosetTable<T, N>::process_deductions ()
 {
   while (!deduction_stack.is_empty ())
     {
-      if (deduction_stack.is_full ())
+      // If deductions have been lost, recover them by a full scan.
+      if (deduction_stack.has_overflowed ())
 	{
 	  lookahead ();
 	  deduction_stack.erase ();
@@ -385,39 +1057,359 @@ CosetTable::process_deductions ()
       deduction_stack.pop (d);
       coset k = d.c;
       gen x = d.x;
-      vector<word> relx = relator_grouped[x];
-      const int n = relx.size ();
-      for (int i = 0; i < n && isalive (k); i++)
-	scan (k, relx[i], true);
-      // No need to continue with this deduction if k died.
-      if (!isalive (k))
+      for (int i = conjugates.begin (x); i < conjugates.end (x)
+	     && isalive (k); i++)
+	scan (k, conjugates.letters (i), conjugates.length (i), true);
+      // No need to continue with this deduction if k died.  (If its
+      // row has been reused in the meantime, tab (k, x) may be
+      // undefined.)
+      if (!isalive (k) || !isdefined (k, x))
 	continue;
-      k = tab[k][x];
+      k = tab (k, x);
       x = inv (x);
-      relx = relator_grouped[x];
-      for (int i = 0; i < n && isalive (k); i++)
-	scan (k, relx[i], true);
+      for (int i = conjugates.begin (x); i < conjugates.end (x)
+	     && isalive (k); i++)
+	scan (k, conjugates.letters (i), conjugates.length (i), true);
     }
 }
 
-int
-CosetTable::getnlive () const
+template <class T, int N>
+long
+CosetTable<T, N>::getnlive () const
 {
-  int count = 0;
-  const int n = tab.size ();
-  for (coset k = 0; k < n; k++)
-    if (isalive (k))
-      count++;
-  return count;
+  return count_fixed_points (&p.parents ()[0], tab.size ());
+}
+
+template <class T, int N>
+EnumStats
+CosetTable<T, N>::getstats () const
+{
+  EnumStats s = stats;
+  s.stack_overflows = deduction_stack.get_noverflows ();
+  s.deductions_dropped = deduction_stack.get_ndropped ();
+  return s;
+}
+
+template <class T, int N>
+void
+CosetTable<T, N>::lookahead (coset start, bool save)
+{
+  if (pool)
+    {
+      for (int round = 0; round < LOOKAHEAD_ROUNDS; round++)
+	if (!parallel_lookahead (start, save))
+	  break;
+      return;
+    }
+  stats.lookaheads++;
+  if (interleaving ())
+    {
+      interleaved_scans (start, tab.size (), save);
+      return;
+    }
+  for (coset k = start; k < tab.size (); k++)
+    for (size_t i = 0; i < relator.size () && isalive (k); i++)
+      scan (k, relator[i], save);
+}
+
+// Scan every relator at every live coset c with first <= c < last,
+// in order, as the serial lookahead does, but with SCAN_LANES scans
+// in flight at once, as in find_closed.  Each lane follows its
+// relator forward and then backward, without changing the table.
+//
+// Unlike find_closed, the scans must take effect in order.  Lanes
+// finish in any order, but their results are retired in order,
+// from a window of the last SCAN_WINDOW scans started.  Most scans
+// yield nothing and are simply dropped.  The others are done for real
+// with scan.  If that changes the table, every scan started before
+// the change is done with scan as well when its turn comes, so the
+// result is the same as scanning one relator at a time.
+template <class T, int N>
+void
+CosetTable<T, N>::interleaved_scans (coset first, coset last, bool save)
+{
+  struct Lane
+  {
+    coset f, b;			// ends of the scan
+    const gen* w;
+    int i, j;			// next letters forward and backward
+    bool forward;
+    long seq;			// position in the order of scans
+  };
+  struct Result
+  {
+    coset k;
+    int rel;
+    bool done, useful;
+    unsigned long epoch;	// value of changes when started
+  };
+  const int nrel = relator.size ();
+  unsigned long changes = 0;	// scans so far that changed the table
+  Result window[SCAN_WINDOW];
+  long started = 0, retired = 0;
+  coset c = first;		// The next scan to start is relator r at c.
+  int r = 0;
+  auto start = [&] (Lane& l) -> bool
+    {
+      if (started - retired == SCAN_WINDOW)
+	return false;
+      while (c < last && (r == nrel || !isalive (c)))
+	{
+	  c++;
+	  r = 0;
+	}
+      if (c >= last)
+	return false;
+      Result& res = window[started & (SCAN_WINDOW - 1)];
+      res.k = c;
+      res.rel = r;
+      res.done = false;
+      res.epoch = changes;
+      l.f = l.b = c;
+      l.w = relator[r].data ();
+      l.i = 0;
+      l.j = relator[r].size () - 1;
+      l.forward = true;
+      l.seq = started++;
+      r++;
+      return true;
+    };
+  // Follow one more letter; return true when the scan is finished.
+  auto step = [&] (Lane& l) -> bool
+    {
+      Result& res = window[l.seq & (SCAN_WINDOW - 1)];
+      if (l.forward)
+	{
+	  const coset g = tab (l.f, l.w[l.i]);
+	  if (g >= 0)
+	    {
+	      l.f = g;
+	      if (++l.i <= l.j)
+		{
+		  tab.prefetch (g, l.w[l.i]);
+		  return false;
+		}
+	      res.done = true;
+	      res.useful = (l.f != l.b);
+	      return true;
+	    }
+	  l.forward = false;
+	}
+      const coset g = tab (l.b, inv (l.w[l.j]));
+      if (g >= 0)
+	{
+	  l.b = g;
+	  if (--l.j >= l.i)
+	    {
+	      tab.prefetch (g, inv (l.w[l.j]));
+	      return false;
+	    }
+	}
+      res.done = true;
+      // As in scan: a coincidence, a deduction, or a gap to fill.
+      res.useful = (l.j <= l.i || (l.j == l.i + 1 && save && gap_fill));
+      return true;
+    };
+  Lane lane[SCAN_LANES];
+  int nlanes = 0;
+  for (;;)
+    {
+      while (nlanes < SCAN_LANES && start (lane[nlanes]))
+	nlanes++;
+      if (nlanes == 0 && retired == started)
+	return;
+      for (int j = 0; j < nlanes; )
+	if (!step (lane[j]))
+	  j++;
+	else if (!start (lane[j]))
+	  lane[j] = lane[--nlanes];
+      for (; retired < started; retired++)
+	{
+	  const Result& res = window[retired & (SCAN_WINDOW - 1)];
+	  if (!res.done)
+	    break;
+	  if ((res.useful || res.epoch != changes) && isalive (res.k))
+	    {
+	      const unsigned long before = stats.deductions
+		+ stats.coincidences;
+	      scan (res.k, relator[res.rel], save);
+	      if (stats.deductions + stats.coincidences != before)
+		changes++;
+	    }
+	}
+    }
 }
 
+// Would scanning w at k yield a deduction or a coincidence?  Only
+// reads the table.
+template <class T, int N>
+bool
+CosetTable<T, N>::yields_info (coset k, const word& w) const
+{
+  int i = 0, j = w.size () - 1;
+  coset f = k, b = k;
+  while (i <= j && isdefined (f, w[i]))
+    f = tab (f, w[i++]);
+  if (i > j)
+    return f != b;
+  while (j >= i && isdefined (b, inv (w[j])))
+    b = tab (b, inv (w[j--]));
+  return j <= i;
+}
+
+// One lookahead pass in two phases.  First the workers scan the
+// relators at all cosets from start on, without changing the table,
+// and note the scans that would yield a deduction or coincidence.
+// Then those scans are done for real, in coset order, by this thread.
+// Since the table changes during the second phase, a scan can yield
+// less (or more) than the first phase predicted; scan copes with
+// that.  Return true if the first phase found anything, in which case
+// another pass may find more.
+template <class T, int N>
+bool
+CosetTable<T, N>::parallel_lookahead (coset start, bool save)
+{
+  const coset n = tab.size ();
+  const int nrel = relator.size ();
+  if (start >= n)
+    return false;
+  const int ntasks = (long (n) - start + LOOKAHEAD_TASK - 1) / LOOKAHEAD_TASK;
+  stats.lookaheads++;
+  vector< vector< pair<coset, int> > > found (ntasks);
+  pool->run (ntasks, [&] (int t)
+    {
+      const coset first = start + long (t) * LOOKAHEAD_TASK;
+      const coset last = min (long (first) + LOOKAHEAD_TASK, long (n));
+      for (coset k = first; k < last; k++)
+	if (isalive (k))
+	  for (int i = 0; i < nrel; i++)
+	    if (yields_info (k, relator[i]))
+	      found[t].push_back (make_pair (k, i));
+    });
+  bool any = false;
+  for (int t = 0; t < ntasks; t++)
+    for (size_t j = 0; j < found[t].size (); j++)
+      {
+	any = true;
+	const coset k = found[t][j].first;
+	if (isalive (k))
+	  scan (k, relator[found[t][j].second], save);
+      }
+  return any;
+}
+
+// The table may hold at most MAXCOSETS rows, whether because of -M or
+// a memory limit.  Before each step of the main loop, make sure that
+// there is room for the rows the step might define, so that we stop
+// between steps rather than in the middle of one.  If there isn't
+// room, HLT looks ahead from coset k, which frees the rows of the
+// cosets it kills for reuse; Felsch has no such recourse, since it
+// only defines cosets that are needed.  If the lookahead doesn't free
+// enough rows for an HLT step but there are enough for a Felsch step,
+// HLT (or the hybrid method) switches to Felsch, setting method, for
+// the rest of the enumeration; the caller has to hand over to felsch.
+// Throw Enumeration_Failed if there is still not enough room.  Return
+// the coset to process, which is k unless k has died, or -1 if there
+// is none left.
+template <class T, int N>
+typename CosetTable<T, N>::coset
+CosetTable<T, N>::make_room (coset k)
+{
+  // A Felsch step defines at most NGENS cosets, and fill_gap at most
+  // one more before each of those.
+  const long felsch_need = (gap_fill ? 2 : 1) * NGENS;
+  const long need = (method == FELSCH ? felsch_need
+		     : max (step_rows, felsch_need));
+  if (room () >= need)
+    return k;
+  if (method != FELSCH)
+    {
+      if (verbose)
+	cout << "\nCoset table is nearly full; " << stats.live
+	     << " live cosets.  Looking ahead...\n";
+      // In a hybrid enumeration, the cosets before k aren't
+      // necessarily closed, and deductions must be followed up.
+      if (method == HYBRID)
+	{
+	  lookahead (0, true);
+	  process_deductions ();
+	}
+      else
+	lookahead (k);
+      if (verbose)
+	cout << "Now " << stats.live << " live cosets.\n";
+      if (!isalive (k) && (k = next_to_process ()) < 0)
+	return -1;
+      if (room () >= need)
+	return k;
+      if (room () >= felsch_need)
+	{
+	  if (verbose)
+	    cout << "Not enough room for HLT steps; switching to Felsch.\n";
+	  // HLT doesn't save its deductions, so Felsch starts from a
+	  // lookahead over the whole table that does.
+	  if (method != HYBRID)
+	    {
+	      build_conjugates ();
+	      lookahead (0, true);
+	      process_deductions ();
+	      if (!isalive (k) && (k = next_to_process ()) < 0)
+		return -1;
+	    }
+	  method = FELSCH;
+	  return k;
+	}
+    }
+  ostringstream os;
+  os << "Coset table is full, with " << stats.live << " live cosets";
+  if (memory_limit > 0)
+    os << " (memory limit " << memory_limit << " bytes)";
+  os << ".";
+  throw Enumeration_Failed (os.str ());
+}
+
+// Limit the table to the number of rows that fit in the given number
+// of bytes.  Besides its entries, each row may need one element of
+// the equivalence relation, one of the coincidence queue and two of
+// the revisit queue, a flag in skip, and up to two bits per entry in
+// the deduction stack's record of what it holds.  A tenth of the
+// limit is left over for everything else; the deduction stack's
+// items get half of that, and its maximum size is lowered if
+// necessary so that they fit (an overflow is recovered by lookahead).
+// Space for the equivalence relation is reserved at once, so that it
+// is never copied (and briefly held twice) as it grows; the table
+// itself grows in place, never beyond MAXCOSETS rows.  Reserved
+// memory is only touched as rows are used.
+template <class T, int N>
 void
-CosetTable::lookahead (coset start)
+CosetTable<T, N>::set_memory_limit (size_t bytes)
 {
-  const int n = tab.size ();
-  for (coset k = start; k < n; k++)
-    for (int i = 0; i < relator.size () && isalive (k); i++)
-      scan (k, relator[i]);
+  memory_limit = bytes;
+  reuse_rows = true;
+  const size_t row_bytes = (NGENS + 4) * sizeof (T) + 1 + (NGENS + 3) / 4;
+  const size_t rows = bytes / 10 * 9 / row_bytes;
+  if (long (rows) < MAXCOSETS)
+    MAXCOSETS = rows;
+  tab.set_max_rows (MAXCOSETS);
+  // The item vector may have up to twice as many elements allocated
+  // as are in use.
+  const size_t stack_items = max (bytes / 20 / (2 * sizeof (deduction)),
+				  size_t (1));
+  if (deduction_stack.get_max () > stack_items)
+    deduction_stack.set_max (stack_items);
+  try
+    {
+      p.reserve (MAXCOSETS);
+      skip.reserve (MAXCOSETS);
+    }
+  catch (bad_alloc&)
+    {
+      ;	 // Then the rows will be allocated as needed.
+    }
+  catch (length_error&)
+    {
+      ;				// ditto
+    }
 }
 
 // When compress is called after lookahead in hlt_plus, we have some
@@ -425,81 +1417,532 @@ CosetTable::lookahead (coset start)
 // compression, we need to resume processing at the same coset, which
 // may have been renumbered; compress returns the new number (or -1 if
 // a current live coset wasn't specified).
-CosetTable::coset
-CosetTable::compress (coset current)
+template <class T, int N>
+typename CosetTable<T, N>::coset
+CosetTable<T, N>::compress (coset current)
 {
+  stats.compressions++;
   coset l = 0;
-  const int n = tab.size ();
+  const coset n = tab.size ();
   coset ret = -1;
+  // The cursor, declined, and the revisit queue refer to rows and
+  // table sizes, which must be renumbered as well.  Any position q
+  // becomes the number of live cosets before q.
+  deque< pair<coset, coset> > live;
+  for (size_t i = 0; i < revisit.size (); i++)
+    if (isalive (revisit[i].first))
+      live.push_back (revisit[i]);
+  revisit.swap (live);
+  vector< pair<coset, coset*> > refs;
+  refs.push_back (make_pair (cursor, &cursor));
+  refs.push_back (make_pair (declined, &declined));
+  for (size_t i = 0; i < revisit.size (); i++)
+    {
+      refs.push_back (make_pair (revisit[i].first, &revisit[i].first));
+      refs.push_back (make_pair (revisit[i].second, &revisit[i].second));
+    }
+  sort (refs.begin (), refs.end ());
+  // Move the live rows down, numbering the live cosets in order.  The
+  // new numbers overwrite the equivalence relation, which is rebuilt
+  // afterwards; newnum[k] is the new number of k, or -1 if k is dead.
+  vector<coset>& newnum = p.parents ();
+  size_t j = 0;
   for (coset k = 0; k < n; k++)
-    if (isalive (k))
-      {
-	if (k == current)
-	  ret = l;
-	if (k > l)		// Replace k by l in table
-	  {
-	    for (gen x = 0; x < NGENS; x++)
-	      {
-		coset m = tab[k][x];
-		if (m == k)
-		  tab[l][x] = l;
-		else
-		  {
-		    tab[l][x] = m;
-		    if (m >= 0)
-		      tab[m][inv (x)] = l;
-		  }
-	      }
-	  }
-	l++;
-      }
-  p = EquivReln (l);
-  if (l < n)
-    tab.erase (tab.begin () + l, tab.end ());
+    {
+      for (; j < refs.size () && refs[j].first == k; j++)
+	*refs[j].second = l;
+      if (newnum[k] != k)	// k is dead
+	{
+	  newnum[k] = -1;
+	  continue;
+	}
+      if (k == current)
+	ret = l;
+      skip[l] = skip[k];
+      if (k > l)
+	copy (tab.row (k), tab.row (k) + NGENS, tab.row (l));
+      newnum[k] = l++;
+    }
+  for (; j < refs.size (); j++)
+    *refs[j].second = l;
+  // The live rows only refer to live cosets.
+  tab.truncate (l);
+  if (l > 0)
+    remap (tab.row (0), l * NGENS, &newnum[0]);
+  skip.resize (l);
+  p = EquivReln<T> (l);
+  free_rows = -1;
+  nfree = 0;
   return ret;
 }
       
-// Swap two distinct live rows of the coset table
+// Renumber the cosets of a compressed coset table, coset k becoming
+// newnum[k]; newnum must be a permutation of 0,...,n-1.  The rows are
+// moved into place by following the cycles of the permutation, so
+// this takes time proportional to the size of the table and needs
+// only one row of extra space.  newnum is destroyed.
+template <class T, int N>
 void
-CosetTable::swap (coset k, coset l)
+CosetTable<T, N>::renumber (vector<coset>& newnum)
 {
-  for (gen x = 0; x < NGENS; x++)
+  const coset n = tab.size ();
+  if (n > 0)
+    remap (tab.row (0), n * NGENS, &newnum[0]);
+  vector<coset> temp (NGENS);
+  for (coset k = 0; k < n; k++)
     {
-      const coset temp = tab[k][x];
-      tab[k][x] = tab[l][x];
-      tab[l][x] = temp;
-      const int n = tab.size ();
-      for (coset m = 0; m < n; m++)
+      // Move the cycle through k: row k goes to newnum[k], whose row
+      // goes to newnum[newnum[k]], and so on back to k.
+      if (newnum[k] < 0 || newnum[k] == k)
+	continue;
+      copy (tab.row (k), tab.row (k) + NGENS, temp.begin ());
+      coset l = newnum[k];
+      newnum[k] = -1;
+      while (l >= 0)
 	{
-	  if (!isalive (m))
-	    continue;
-	  if (tab[m][x] == k)
-	    tab[m][x] = l;
-	  else if (tab[m][x] == l)
-	    tab[m][x] = k;
+	  for (gen x = 0; x < NGENS; x++)
+	    ::swap (temp[x], tab (l, x));
+	  coset m = newnum[l];
+	  newnum[l] = -1;
+	  l = m;
 	}
     }
 }
 
-// Standardize a complete compressed coset table
+// Compress the table after a lookahead in hlt_plus and renumber the
+// cosets that have been processed, so that cosets which are close
+// together in the Schreier graph are close together in the table as
+// well.  A breadth-first search starts from the cosets still to be
+// processed, in the order in which they will be processed, beginning
+// with k, which is about to be.  The processed cosets are numbered
+// backwards from the cursor in the order in which the search reaches
+// them, so that the neighbours of the next cosets to be processed end
+// up just behind them; any not reached go first, in their old order.
+// The cosets still to be processed keep their numbers, except for
+// those waiting on the revisit queue behind the cursor, which keep
+// their place in the queue, so HLT carries on in the same order.
+// Returns the new number of k.
+template <class T, int N>
+typename CosetTable<T, N>::coset
+CosetTable<T, N>::localize (coset k)
+{
+  k = compress (k);
+  const coset n = tab.size ();
+  vector<coset> newnum (n, -1), order;
+  vector<bool> seen (n, false);
+  order.reserve (n);
+  coset top = cursor;		// the last number handed out
+  auto reach = [&] (coset l)
+    {
+      if (seen[l])
+	return;
+      seen[l] = true;
+      order.push_back (l);
+      if (l < cursor)
+	newnum[l] = --top;
+    };
+  reach (k);
+  for (size_t i = 0; i < revisit.size (); i++)
+    reach (revisit[i].first);
+  for (coset l = cursor; l < n; l++)
+    reach (l);
+  for (size_t i = 0; i < order.size (); i++)
+    for (gen x = 0; x < NGENS; x++)
+      {
+	coset l = tab (order[i], x);
+	if (l >= 0)
+	  reach (l);
+      }
+  vector<coset> ().swap (order);
+  coset m = 0;
+  for (coset l = 0; l < cursor; l++)
+    if (newnum[l] < 0)
+      newnum[l] = m++;
+  for (coset l = cursor; l < n; l++)
+    newnum[l] = l;
+  for (size_t i = 0; i < revisit.size (); i++)
+    revisit[i].first = newnum[revisit[i].first];
+  k = newnum[k];
+  renumber (newnum);
+  return k;
+}
+
+// Standardize a complete compressed coset table: number the cosets in
+// the order in which they are first reached when the rows are read in
+// order, starting from coset 0.  A breadth-first search finds the
+// new numbers in one pass.
+template <class T, int N>
 void
-CosetTable::standardize ()
+CosetTable<T, N>::standardize ()
 {
-  const int n = tab.size ();
+  const coset n = tab.size ();
   if (n <= 2)
     return;
-  coset goal = 1;	   // next coset number we want to find in the table
-  for (tab_iter it = tab.begin (); it != tab.end (); it++)
+  vector<coset> newnum (n, -1), order;
+  order.reserve (n);
+  newnum[0] = 0;
+  order.push_back (0);
+  for (size_t i = 0; i < order.size (); i++)
     for (gen x = 0; x < NGENS; x++)
       {
-	coset l = (*it)[x];
-	if (l >= goal)
+	coset l = tab (order[i], x);
+	if (l >= 0 && newnum[l] < 0)
 	  {
-	    if (l > goal)
-	      swap (l, goal);
-	    goal++;
-	    if (goal == n - 1)
-	      return;
+	    newnum[l] = order.size ();
+	    order.push_back (l);
 	  }
       }
+  // Cosets not reached from 0 (only possible if the table is
+  // incomplete) keep their relative order at the end.
+  for (coset k = 0; k < n; k++)
+    if (newnum[k] < 0)
+      {
+	newnum[k] = order.size ();
+	order.push_back (k);
+      }
+  vector<coset> ().swap (order);
+  renumber (newnum);
+}
+
+// Checkpoints.  A checkpoint file holds a header describing the
+// enumeration (coset width, method and its options, maximum table
+// size, presentation) followed by the complete state of the table at
+// the start of some iteration of the main loop: the table, the
+// equivalence relation, the processing order, the coincidence queue,
+// the deduction stack, the statistics and the position in the hybrid
+// strategy.  Integers are stored in native byte order, so a
+// checkpoint can only be resumed on the same kind of machine.
+
+volatile sig_atomic_t checkpoint_requested = 0;
+
+static const char CHECKPOINT_MAGIC[8] = "TCCKPT6";
+static const char CHECKPOINT_END[8] = "TCCKEND";
+
+template <class X>
+static void
+put (ostream& os, X x)
+{
+  os.write ((const char*) &x, sizeof x);
+}
+
+template <class X>
+static bool
+get (istream& is, X& x)
+{
+  return bool (is.read ((char*) &x, sizeof x));
+}
+
+static void
+put_strings (ostream& os, const vector<string>& v)
+{
+  put<int32_t> (os, v.size ());
+  for (size_t i = 0; i < v.size (); i++)
+    {
+      put<int32_t> (os, v[i].size ());
+      os.write (v[i].data (), v[i].size ());
+    }
+}
+
+static bool
+get_strings (istream& is, vector<string>& v)
+{
+  int32_t n, len;
+  if (!get (is, n) || n < 0)
+    return false;
+  for (int i = 0; i < n; i++)
+    {
+      if (!get (is, len) || len < 0)
+	return false;
+      string s (len, ' ');
+      if (len > 0 && !is.read (&s[0], len))
+	return false;
+      v.push_back (s);
+    }
+  return true;
+}
+
+template <class T, int N>
+void
+CosetTable<T, N>::set_checkpoint (const string& file, int seconds)
+{
+  checkpoint_file = file;
+  checkpoint_interval = seconds;
+  next_checkpoint = time (0) + seconds;
+}
+
+// Called from the main loops just before coset k is processed.  The
+// file is written under a temporary name and then renamed, so that a
+// crash while writing leaves the previous checkpoint intact.
+template <class T, int N>
+void
+CosetTable<T, N>::checkpoint (coset k)
+{
+  const string tmp = checkpoint_file + ".tmp";
+  ofstream out (tmp.c_str (), ios::binary);
+  if (out)
+    save (out, k);
+  out.close ();
+  if (!out || rename (tmp.c_str (), checkpoint_file.c_str ()) != 0)
+    {
+      cerr << "\nUnable to write checkpoint " << checkpoint_file << ".\n";
+      remove (tmp.c_str ());
+      // Rather than trying again at every tick, give up on a
+      // checkpoint requested by SIGTERM; the user wants us to stop.
+      if (checkpoint_requested)
+	{
+	  cerr << "Exiting.\n";
+	  exit (EXIT_FAILURE);
+	}
+    }
+  else if (checkpoint_requested)
+    {
+      cerr << "\nCheckpoint written to " << checkpoint_file
+	   << "; exiting.\n";
+      exit (EXIT_FAILURE);
+    }
+  next_checkpoint = time (0) + checkpoint_interval;
+}
+
+template <class T, int N>
+void
+CosetTable<T, N>::save (ostream& out, coset k) const
+{
+  out.write (CHECKPOINT_MAGIC, sizeof CHECKPOINT_MAGIC);
+  put<int32_t> (out, sizeof (T));
+  put<int32_t> (out, method);
+  put<int64_t> (out, strategy.hlt_cosets);
+  put<int64_t> (out, strategy.felsch_cosets);
+  put<int64_t> (out, strategy.lookahead_every);
+  put<int32_t> (out, gap_fill);
+  put<int32_t> (out, renumbering);
+  put<int32_t> (out, NGENS);
+  put<int64_t> (out, MAXCOSETS);
+  put_strings (out, alphabet.names ());
+  put_strings (out, rel_strings);
+  put_strings (out, gen_H_strings);
+
+  const long n = tab.size ();
+  put<int64_t> (out, n);
+  out.write ((const char*) tab.row (0), n * NGENS * sizeof (T));
+  out.write ((const char*) &p.parents ()[0], n * sizeof (T));
+  vector<char> sk (skip.begin (), skip.end ());
+  out.write (&sk[0], n);
+  put<int64_t> (out, k);
+  put<int64_t> (out, free_rows);
+  put<int64_t> (out, cursor);
+  put<int64_t> (out, revisit.size ());
+  for (size_t i = 0; i < revisit.size (); i++)
+    {
+      put<int64_t> (out, revisit[i].first);
+      put<int64_t> (out, revisit[i].second);
+    }
+  queue<coset> qq = q;
+  put<int64_t> (out, qq.size ());
+  for (; !qq.empty (); qq.pop ())
+    put<int64_t> (out, qq.front ());
+  const vector<deduction>& ded = deduction_stack.contents ();
+  put<int64_t> (out, ded.size ());
+  for (size_t i = 0; i < ded.size (); i++)
+    {
+      put<int64_t> (out, ded[i].c);
+      put<int32_t> (out, ded[i].x);
+    }
+  put (out, stats);
+  put<int64_t> (out, phase_pos);
+  put<uint64_t> (out, next_lookahead);
+  out.write (CHECKPOINT_END, sizeof CHECKPOINT_END);
+}
+
+// Read the state saved by save, starting after the header.  The
+// table must still be fresh, as made by the constructor.
+template <class T, int N>
+void
+CosetTable<T, N>::restore ()
+{
+  ifstream in (resume_file.c_str (), ios::binary);
+  in.seekg (resume_offset);
+  int64_t n, k, f, c, m, x1, x2;
+  bool ok = get (in, n) && n > 0;
+  if (ok)
+    try
+      {
+	tab.reserve (n);
+	while (tab.size () < n)
+	  tab.add_row ();
+      }
+    catch (bad_alloc&)
+      {
+	throw Enumeration_Failed ("Not enough memory to resume from "
+				  + resume_file + ".");
+      }
+  vector<T> parent (ok ? n : 0);
+  vector<char> sk (ok ? n : 0);
+  ok = (ok && in.read ((char*) tab.row (0), n * NGENS * sizeof (T))
+	&& in.read ((char*) &parent[0], n * sizeof (T))
+	&& in.read (&sk[0], n)
+	&& get (in, k) && get (in, f) && get (in, c) && get (in, m));
+  if (ok)
+    {
+      p.assign (parent);
+      skip.assign (sk.begin (), sk.end ());
+      resume_at = k;
+      free_rows = f;
+      nfree = 0;
+      for (coset l = free_rows; l >= 0; l = tab (l, 0))
+	nfree++;
+      cursor = c;
+      revisit.clear ();
+      for (int64_t i = 0; ok && i < m; i++)
+	if ((ok = get (in, x1) && get (in, x2)))
+	  revisit.push_back (make_pair (coset (x1), coset (x2)));
+    }
+  if (ok && (ok = get (in, m)))
+    for (int64_t i = 0; ok && i < m; i++)
+      if ((ok = get (in, x1)))
+	q.push (x1);
+  if (ok && (ok = get (in, m)))
+    {
+      deduction_stack.erase ();
+      for (int64_t i = 0; ok && i < m; i++)
+	{
+	  deduction d;
+	  int32_t x;
+	  if ((ok = get (in, d.c) && get (in, x)))
+	    {
+	      d.x = x;
+	      deduction_stack.push (d);
+	    }
+	}
+    }
+  char end[sizeof CHECKPOINT_END];
+  int64_t pos;
+  uint64_t next;
+  ok = (ok && get (in, stats) && get (in, pos) && get (in, next)
+	&& in.read (end, sizeof end)
+	&& memcmp (end, CHECKPOINT_END, sizeof end) == 0);
+  if (!ok)
+    {
+      throw Enumeration_Failed ("Checkpoint file " + resume_file
+				+ " is damaged.");
+    }
+  phase_pos = pos;
+  next_lookahead = next;
+  resume_file.clear ();
+  progress.restart (stats.defined);
+}
+
+// Return a new table for the given alphabet, specialized on the
+// number of columns if it is small.
+template <class T>
+static CosetTableBase*
+make_table (const Alphabet& A, const vector<string>& rel,
+	    const vector<string>& gen_H, bool felsch, long maxcosets)
+{
+  switch (A.size ())
+    {
+    case 4:
+      return new CosetTable<T, 4> (A, rel, gen_H, felsch, maxcosets);
+    case 6:
+      return new CosetTable<T, 6> (A, rel, gen_H, felsch, maxcosets);
+    default:
+      return new CosetTable<T> (A, rel, gen_H, felsch, maxcosets);
+    }
+}
+
+template <class T>
+static CosetTableBase*
+resume_table (const Alphabet& A, const vector<string>& rel,
+	      const vector<string>& gen_H, int method, const Strategy& s,
+	      bool gap_fill, bool renumbering, long maxcosets,
+	      const string& file, long offset)
+{
+  CosetTableBase* ctp = make_table<T> (A, rel, gen_H, method < 0,
+				       maxcosets);
+  ctp->set_strategy (s);
+  ctp->set_gap_fill (gap_fill);
+  ctp->set_renumbering (renumbering);
+  ctp->resume_from (file, offset);
+  return ctp;
+}
+
+CosetTableBase*
+open_checkpoint (const string& file, int& method)
+{
+  ifstream in (file.c_str (), ios::binary);
+  char magic[sizeof CHECKPOINT_MAGIC];
+  int32_t bytes, meth, gap_fill, renumbering, NG;
+  int64_t maxcosets;
+  Strategy s;
+  vector<string> names, rel, gen_H;
+  if (!in.read (magic, sizeof magic)
+      || memcmp (magic, CHECKPOINT_MAGIC, sizeof magic) != 0
+      || !get (in, bytes) || !get (in, meth) || !get (in, s.hlt_cosets)
+      || !get (in, s.felsch_cosets) || !get (in, s.lookahead_every)
+      || !get (in, gap_fill) || !get (in, renumbering) || !get (in, NG)
+      || !get (in, maxcosets) || !get_strings (in, names)
+      || !get_strings (in, rel) || !get_strings (in, gen_H)
+      || 2 * long (names.size ()) != NG)
+    return 0;
+  const Alphabet A (names);
+  const long offset = in.tellg ();
+  method = meth;
+  switch (bytes)
+    {
+    case 2:
+      return resume_table<int16_t> (A, rel, gen_H, meth, s, gap_fill,
+				    renumbering, maxcosets, file, offset);
+    case 4:
+      return resume_table<int32_t> (A, rel, gen_H, meth, s, gap_fill,
+				    renumbering, maxcosets, file, offset);
+    case 8:
+      return resume_table<int64_t> (A, rel, gen_H, meth, s, gap_fill,
+				    renumbering, maxcosets, file, offset);
+    default:
+      return 0;
+    }
+}
+
+bool
+parse_strategy (const string& spec, Strategy& s)
+{
+  istringstream is (spec);
+  char c1, c2;
+  s = Strategy ();
+  if (!(is >> s.hlt_cosets >> c1 >> s.felsch_cosets) || c1 != ',')
+    return false;
+  if (is >> c2 && (c2 != ',' || !(is >> s.lookahead_every)))
+    return false;
+  is >> ws;
+  return (is.eof () && s.hlt_cosets >= 0 && s.felsch_cosets >= 0
+	  && s.hlt_cosets + s.felsch_cosets > 0 && s.lookahead_every >= 0);
+}
+
+
+CosetTableBase*
+new_coset_table (const Alphabet& A, vector<string> rel, vector<string> gen_H,
+		 int method, long maxcosets)
+{
+  const bool felsch = (method < 0);	// Felsch or hybrid
+  long need = maxcosets;
+  if (need <= 0 && method > 0)
+    {
+      // HLT+ checks the threshold only between cosets, so the table
+      // can overshoot it by the number of definitions made while
+      // processing one coset.  Scanning the generators of H at the
+      // start isn't checked at all.
+      long hlen = 0, slack = A.size ();
+      word w;
+      for (size_t i = 0; i < gen_H.size (); i++)
+	if (A.string_to_word (w, gen_H[i]))
+	  hlen += w.size ();
+      for (size_t i = 0; i < rel.size (); i++)
+	if (A.string_to_word (w, rel[i]))
+	  slack += w.size ();
+      need = max (long (method), hlen + 1) + slack;
+    }
+  if (need > 0 && need <= numeric_limits<int16_t>::max ())
+    return make_table<int16_t> (A, rel, gen_H, felsch, maxcosets);
+  if (need <= numeric_limits<int32_t>::max ())
+    return make_table<int32_t> (A, rel, gen_H, felsch, maxcosets);
+  return make_table<int64_t> (A, rel, gen_H, felsch, maxcosets);
 }
@@ -24,65 +24,284 @@
 
 #include <vector>
 #include <queue>
-#include <map>
+#include <deque>
+#include <unordered_map>
 #include <iostream>
+#include <string>
+#include <csignal>
+#include <ctime>
 
 #include "gens_and_words.h"
+#include "alphabet.h"
 #include "stack.h"
 #include "equivreln.h"
+#include "table.h"
+#include "relindex.h"
+#include "workerpool.h"
+#include "stats.h"
+#include "progress.h"
 
 /* The CosetTable class provides a toy implementation of the HLT,
    HLT+lookahead, and Felsch algorithms for coset enumeration.  I have
    followed fairly closely the pseudocode in Holt's book, Handbook of
    Computational Group Theory, except that cosets are (internally)
-   numbered starting from 0. */
+   numbered starting from 0.  It also provides hybrids of HLT and
+   Felsch; see Strategy below.
 
-class CosetTable
+   CosetTable is a template whose parameter T is the signed integer
+   type used to store coset numbers, so that small enumerations can
+   use a 16-bit table and huge ones a 64-bit table.  If its second
+   parameter N is nonzero, the table only works for presentations
+   with N columns (generators and inverses); since N is then known at
+   compile time, rows have a constant size and loops over a row can
+   be unrolled.  Callers normally work through the CosetTableBase
+   interface and let new_coset_table choose T and N. */
+
+/* A hybrid strategy, in the style of ACE, alternates HLT phases, in
+   which each of hlt_cosets cosets is processed by scanning all the
+   relators at it, with Felsch phases, in which each of felsch_cosets
+   cosets is processed by filling in its row.  In both phases the
+   consequences (deductions) of every new table entry are followed
+   up, as in Felsch, so that the Felsch phases stay valid.  If
+   lookahead_every is positive, a lookahead pass is made over the
+   whole table each time that many more cosets have been defined.
+   Plain HLT and Felsch are the cases felsch_cosets = 0 and
+   hlt_cosets = 0, but the HLT and Felsch methods are faster for
+   those, since they do less bookkeeping. */
+
+struct Strategy
+{
+  explicit Strategy (long h = 0, long f = 0, long l = 0)
+    : hlt_cosets (h), felsch_cosets (f), lookahead_every (l) {}
+  long hlt_cosets;
+  long felsch_cosets;
+  long lookahead_every;
+};
+
+/* Parse a strategy written as H,F or H,F,L (hlt_cosets, felsch_cosets
+   and lookahead_every).  Return false if spec is invalid. */
+bool parse_strategy (const std::string& spec, Strategy& s);
+
+class CosetTableBase
 {
  public:
-  typedef std::vector<int> row;
-  typedef int coset;
-  typedef int gen;
-  typedef std::vector<row>::iterator tab_iter;
-  typedef std::vector<row>::const_iterator ctab_iter;
-  friend std::ostream& operator<< (std::ostream&, const CosetTable&);
-  CosetTable (int NG, std::vector<std::string> rel,
-	      std::vector<std::string> gen_H, bool felsch);
+  virtual ~CosetTableBase () {}
+  enum {FELSCH = -1, HYBRID = -2};
   /* method can be a positive integer (threshold for HLT+), 0 (for
-     ordinary HLT) or negative (for Felsch). */
+     ordinary HLT), FELSCH or HYBRID (using the strategy given to
+     set_strategy).  Throws Enumeration_Failed if the table can't be
+     made big enough. */
+  virtual void enumerate (int method) = 0;
+  /* Only for tables made by new_coset_table with method HYBRID. */
+  virtual void set_strategy (const Strategy&) = 0;
+  virtual void compress () = 0;
+  virtual void standardize () = 0;
+  virtual long getnlive () const = 0;
+  virtual long getsize () const = 0;
+  virtual EnumStats getstats () const = 0;
+  virtual int coset_bits () const = 0;
+  virtual bool use_table_file (const std::string& f) = 0;
+  virtual void set_deduction_limit (size_t n) = 0;
+  virtual void set_threads (int n) = 0;
+  virtual void set_progress (std::ostream* os, int seconds) = 0;
+  virtual void set_checkpoint (const std::string& file, int seconds) = 0;
+  virtual unsigned long get_ndropped () const = 0;
+  virtual unsigned long get_noverflows () const = 0;
+  virtual void print (std::ostream&) const = 0;
+  virtual bool write_binary (std::ostream&) const = 0;
+  virtual void set_verbose (bool v) = 0;
+  virtual void set_gap_fill (bool g) = 0;
+  /* Only for HLT+lookahead. */
+  virtual void set_renumbering (bool r) = 0;
+  virtual void set_memory_limit (size_t bytes) = 0;
+  /* Used by open_checkpoint. */
+  virtual void resume_from (const std::string& file, long offset) = 0;
+  class Threshold_Exceeded {};	/* exception */
+  class Enumeration_Failed	/* exception */
+  {
+  public:
+    explicit Enumeration_Failed (const std::string& s) : reason (s) {}
+    std::string reason;
+  };
+};
+
+std::ostream& operator<< (std::ostream&, const CosetTableBase&);
+
+/* write_binary writes a compressed table in a form that other
+   programs can mmap and use directly.  All integers are little-endian.
+   There is a 32-byte header:
+
+     bytes  0-7   magic "TCTABLE" followed by a NUL
+     bytes  8-11  format version (1)
+     bytes 12-15  size in bytes of each table entry (4 or 8)
+     bytes 16-23  number of cosets n
+     bytes 24-27  number of columns m (generators and their inverses,
+                  in the order a, A, b, B, ...)
+     bytes 28-31  zero
+
+   followed by the n * m entries, row by row.  Entry (k, x) is the
+   image of coset k under column x, with cosets numbered from 0. */
+
+/* A signal handler can set this to make the enumeration write a
+   checkpoint (if a checkpoint file has been set) and exit. */
+extern volatile std::sig_atomic_t checkpoint_requested;
+
+/* Return a new coset table whose coset numbers are just wide enough
+   for maxcosets cosets.  If maxcosets is 0, the width is chosen from
+   the HLT+ threshold (method > 0), or else defaults to 32 bits.
+   Caller is responsible for deleting. */
+CosetTableBase* new_coset_table (const Alphabet& A,
+				 std::vector<std::string> rel,
+				 std::vector<std::string> gen_H, int method,
+				 long maxcosets = 0);
+
+/* Return a coset table that will carry on, when enumerate is called,
+   from the checkpoint saved in file, and set method to the method
+   that was being used.  Return 0 if file is not a checkpoint.  Caller
+   is responsible for deleting. */
+CosetTableBase* open_checkpoint (const std::string& file, int& method);
+
+template <class T, int N = 0>
+class CosetTable : public CosetTableBase
+{
+ public:
+  typedef T coset;
+  typedef int gen;
+  CosetTable (const Alphabet& A, std::vector<std::string> rel,
+	      std::vector<std::string> gen_H, bool felsch,
+	      long maxcosets = 0);
+  ~CosetTable () { delete pool; }
   void enumerate (int method);
-  int compress (coset current = -1);
+  void compress () { compress (-1); }
+  coset compress (coset current);
   void standardize ();
-  int getnlive () const;
-  int getsize () const { return tab.size (); }
-  class Threshold_Exceeded {};	/* exception */
-  coset action (coset c, gen x) { return tab[c][x]; }
+  long getnlive () const;
+  long getsize () const { return tab.size (); }
+  EnumStats getstats () const;
+  int coset_bits () const { return 8 * sizeof (T); }
+  bool use_table_file (const std::string& f) { return tab.use_file (f); }
+  void set_deduction_limit (size_t n) { deduction_stack.set_max (n); }
+  void set_threads (int n);
+  void set_progress (std::ostream* os, int seconds)
+  { progress.start (os, seconds); }
+  void set_checkpoint (const std::string& file, int seconds);
+  void set_verbose (bool v) { verbose = v; }
+  void set_strategy (const Strategy& s) { strategy = s; }
+  void set_gap_fill (bool g) { gap_fill = g; }
+  void set_renumbering (bool r) { renumbering = r; }
+  void set_memory_limit (size_t bytes);
+  void resume_from (const std::string& file, long offset)
+  { resume_file = file; resume_offset = offset; }
+  unsigned long get_ndropped () const
+  { return deduction_stack.get_ndropped (); }
+  unsigned long get_noverflows () const
+  { return deduction_stack.get_noverflows (); }
+  void print (std::ostream&) const;
+  bool write_binary (std::ostream&) const;
+  coset action (coset c, gen x) const { return tab (c, x); }
  private:
-  int NGENS;
-  std::vector<row> tab;
-  EquivReln p;
+  Alphabet alphabet;
+  Width<N> NGENS;
+  long MAXCOSETS;		/* largest allowed table size */
+  size_t memory_limit;		/* bytes, or 0 for none */
+  long step_rows;		/* most rows one HLT step defines */
+  Strategy strategy;		/* for hybrid */
+  long phase_pos;		/* cosets processed in this cycle of phases */
+  unsigned long next_lookahead;	/* value of stats.defined; for hybrid */
+  int method;			/* as passed to enumerate */
+  std::vector<std::string> rel_strings, gen_H_strings; /* for checkpoints */
+  EnumStats stats;
+  Progress progress;
+  bool verbose;			/* report lookahead in hlt_plus */
+  void tick (coset k)
+  {
+    if (progress.due ())
+      progress.report (k, tab.size (), stats.live, stats.defined);
+    if (!checkpoint_file.empty ()
+	&& (checkpoint_requested || checkpoint_due ()))
+      checkpoint (k);
+  }
+  enum {CHECK_EVERY = 4096};	/* ticks between looks at the clock */
+  std::string checkpoint_file;
+  int checkpoint_interval;	/* seconds, or 0 for signal only */
+  time_t next_checkpoint;
+  unsigned long nticks;
+  bool checkpoint_due ()
+  {
+    return (checkpoint_interval > 0 && ++nticks % CHECK_EVERY == 0
+	    && time (0) >= next_checkpoint);
+  }
+  void checkpoint (coset k);
+  void save (std::ostream&, coset k) const;
+  std::string resume_file;
+  long resume_offset;		/* start of table state in resume_file */
+  coset resume_at;		/* coset to process first, or -1 */
+  void restore ();
+  Table<T, N> tab;
+  EquivReln<T> p;
   std::queue<coset> q;			/* dead cosets to be processed */
+  coset free_rows;		/* first row on free list, or -1 */
+  long nfree;			/* length of free list */
+  bool reuse_rows;		/* see define */
+  long room () const { return MAXCOSETS - tab.size () + nfree; }
+  coset make_room (coset k);
+  coset cursor;			/* next row to process, in row order */
+  std::deque< std::pair<coset, coset> > revisit; /* see next_to_process */
+  std::vector<bool> skip;	/* rows the cursor should skip */
+  coset next_to_process ();
   std::vector<word> relator;
   std::vector<word> generator_of_H;
-  std::map< gen, std::vector<word> > relator_grouped; /* for Felsch */
+  RelatorIndex conjugates;	/* for Felsch */
+  void build_conjugates ();
   void hlt ();
   void hlt_plus (int threshold);
+  void hlt_step (coset k, bool save = false);
+  void hybrid ();
+  WorkerPool* pool;		/* for parallel HLT, or 0 */
+  coset declined;		/* parallel_step gave up on rows before this */
+  struct Delta			/* see process_block */
+  {
+    std::vector<long> rows;	/* entries of the new cosets */
+    std::unordered_map<long, long> entries; /* key c * NGENS + x */
+    std::vector<long> keys;	/* of entries, in order of definition */
+    std::vector< std::pair<long, long> > coincidences;
+    std::vector<coset> redo;	/* steps cut short by a coincidence */
+    unsigned long deductions;
+  };
+  bool parallel_step (coset k, long limit);
+  void process_block (coset first, coset last, Delta& d) const;
+  void apply (const Delta& d);
+  coset add_coset ();
+  bool renumbering;		/* for locality; see localize */
+  coset localize (coset k);
+  bool interleaving () const;	/* is the table big enough */
+  coset pre_first, pre_last;	/* cosets prescanned by prescan */
+  std::vector<char> closed;	/* closed[(k - pre_first) * nrel + i] */
+  void prescan (coset k);
+  void find_closed (coset first, coset last, char* closed) const;
   void felsch ();
+  bool gap_fill;		/* use the preferred definition list */
+  enum {PDL_SIZE = 256};
+  std::deque< std::pair<coset, gen> > preferred; /* see fill_gap */
+  void fill_gap ();
   Stack deduction_stack;	/* for Felsch */
-  void lookahead (coset start = 0);
+  void lookahead (coset start = 0, bool save = false);
+  bool parallel_lookahead (coset start, bool save);
+  void interleaved_scans (coset first, coset last, bool save);
+  bool yields_info (coset k, const word& w) const;
   void process_deductions ();	/* for Felsch */
   void scan_and_fill (coset, const word&, bool save = false);
-  void scan (coset, const word&, bool save = false);
+  void scan (coset, const gen*, int, bool save = false);
+  void scan (coset k, const word& w, bool save = false)
+  { scan (k, w.data (), w.size (), save); }
   bool isalive (coset k) const { return (p (k) == k); }
   void define (coset, gen, bool save = false);
-  bool isdefined (coset k, gen x) const { return (tab[k][x] >= 0); }
-  void undefine (coset k, gen x) { tab[k][x] = -1; }
+  bool isdefined (coset k, gen x) const { return (tab (k, x) >= 0); }
+  void undefine (coset k, gen x) { tab (k, x) = -1; }
   void merge (coset k, coset l)
-  { int m = p.merge (k, l); if (m >= 0) q.push (m); }
+  { coset m = p.merge (k, l); if (m >= 0) q.push (m); }
   void coincidence(coset, coset, bool save = false);
-  void swap (coset, coset l);
+  void renumber (std::vector<coset>& newnum);
 };
 
-std::ostream& operator<< (std::ostream&, const CosetTable&);
-
 #endif	/* COSETTABLE_H */
@@ -20,16 +20,18 @@
    Written by Ken Brown <kbrown@cornell.edu>. */
 
 #include <algorithm>
+#include <stdint.h>
 
 #include "equivreln.h"
 
 using namespace std;
 
 // Return minimal element of equivalence class, simplify p along the way
-int
-EquivReln::rep (int k)
+template <class T>
+T
+EquivReln<T>::rep (T k)
 {
-  int l, m, n;
+  T l, m, n;
   l = k; m = p[l];
   while (m < l)
     {
@@ -48,8 +50,9 @@ EquivReln::rep (int k)
 
 // Merge two equivalence classes.  Return the obsolete representative,
 // or -1 if the classes were already equal.
-int
-EquivReln::merge(int k, int l)
+template <class T>
+T
+EquivReln<T>::merge(T k, T l)
 {
   k = rep (k);
   l = rep (l);
@@ -65,3 +68,7 @@ EquivReln::merge(int k, int l)
     }
   return -1;
 }
+
+template class EquivReln<int16_t>;
+template class EquivReln<int32_t>;
+template class EquivReln<int64_t>;
@@ -28,18 +28,30 @@
    equivalence relation on natural numbers, such that each class is
    represented by its smallest element.  We have f(i) = i if and only
    if i represents its class.  Otherwise, f(i) is a smaller element
-   equivalent to i.  Internally, f is maintained as a vector. */
+   equivalent to i.  Internally, f is maintained as a vector of T's,
+   where T is a signed integer type.  reset (k) makes k a class of
+   its own again; it is only safe if no other element's chain leads
+   through k.  The non-const parents () lets a caller that is about
+   to discard the relation reuse its storage. */
 
+template <class T>
 class EquivReln
 {
  public:
-  explicit EquivReln (int n = 0) { for (int i = 0; i < n; i++) p.push_back (i); }
-  int rep (int);
-  int operator () (int k) const { return p[k]; }
-  int merge (int, int);
+  explicit EquivReln (long n = 0) { for (long i = 0; i < n; i++) p.push_back (i); }
+  T rep (T);
+  T operator () (T k) const { return p[k]; }
+  T merge (T, T);
   void add () { p.push_back (p.size ()); }
+  void reset (T k) { p[k] = k; }
+  long size () const { return p.size (); }
+  const std::vector<T>& parents () const { return p; }
+  std::vector<T>& parents () { return p; }
+  void assign (const std::vector<T>& q) { p = q; }
+  void reserve (long n) { p.reserve (n); }
+  void truncate (long n) { if (n < long (p.size ())) p.resize (n); }
  private:
-  std::vector<int> p;
+  std::vector<T> p;
 };
 
 
@@ -21,20 +21,18 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <vector>
 #include <cstdlib>
 #include <cctype>
+#include <algorithm>
+#include <set>
 
 #include "gens_and_words.h"
+#include "alphabet.h"
 
 using namespace std;
 
-int
-inv (int x)
-{
-  return x % 2 == 0 ? x + 1 : x - 1;
-}
-
 char
 switch_case (char c)
 {
@@ -45,36 +43,6 @@ switch_case (char c)
 }
 
 
-// NGENS is the number of allowed generators, including inverses.
-int
-char_to_gen (char c, int NGENS)
-{
-  size_t found = gens.find_first_of (c);
-  if (found != string::npos && found < NGENS)
-    return found;
-  else
-    return NOTAGEN;
-}
-
-// char
-// gen_to_char (int x)
-// {
-//   return gens[x];
-// }
-
-bool
-string_to_word (word& w, const string& s, int NGENS)
-{
-  for (int i = 0; i < s.size (); i++)
-    {
-      int x;
-      if ((x = char_to_gen (s[i], NGENS)) == NOTAGEN)
-	return false;
-      w.push_back (x);
-    }
-  return true;
-}
-
 #if 0
 // Get an integer from standard input, prompting with errprompt if
 // something other than an integer is entered.  Read newline.
@@ -98,12 +66,12 @@ getnum (const string errprompt)
 // true, or read an empty line and return false.  Always read the
 // terminating newline.
 bool
-getstringword (string& s, int NGENS, istream* inp )
+getstringword (string& s, const Alphabet& A, istream* inp )
 {
   if (!getline (*inp, s) || s.empty ())
     return false;
   word w;
-  if (string_to_word (w, s, NGENS))
+  if (A.string_to_word (w, s))
     return true;
   // s is invalid; give up if not interactive
   if (inp != &cin)
@@ -115,23 +83,23 @@ getstringword (string& s, int NGENS, istream* inp )
   do
     {
       cout << "Invalid word; use alphabet ";
-      for (int x = 0; x < NGENS - 1; x++)
-	cout << gens[x] << ",";
-      cout << gens[NGENS - 1] << ".\n> ";
+      for (int x = 0; x < A.size () - 1; x++)
+	cout << A.name (x) << ",";
+      cout << A.name (A.size () - 1) << ".\n> ";
       getline (cin, s);
       if (s.empty ())
 	return false;
     }
-  while (!string_to_word (w, s, NGENS));
+  while (!A.string_to_word (w, s));
   return true;
 }
 
 // Accumulate valid strings from *inp, one per line, in a vector.
 void
-getvecstringword (vector<string>& v, int NGENS, istream* inp)
+getvecstringword (vector<string>& v, const Alphabet& A, istream* inp)
 {
   string s;
-  while (getstringword (s, NGENS, inp))
+  while (getstringword (s, A, inp))
     {
       v.push_back (s);
       if (inp == &cin)
@@ -139,51 +107,72 @@ getvecstringword (vector<string>& v, int NGENS, istream* inp)
     }
 }
 
-// Read an integer between 1 and 26 from *inp; read newline.
-int
-getngens (istream* inp)
+// Parse a line giving the number n of generators, optionally followed
+// by n distinct names for them.  Return false if it is invalid.
+bool
+parse_generators (const string& line, Alphabet& A)
 {
+  istringstream is (line);
   int n;
+  if (!(is >> n) || n < 1 || n > MAXGENS)
+    return false;
+  vector<string> names;
+  set<string> seen;
+  string name;
+  while (is >> name)
+    {
+      if (!Alphabet::valid_name (name) || !seen.insert (name).second)
+	return false;
+      names.push_back (name);
+    }
+  if (names.empty ())
+    A = Alphabet (n);
+  else if (int (names.size ()) == n)
+    A = Alphabet (names);
+  else
+    return false;
+  return true;
+}
+
+// Read the number of generators, and perhaps their names, from *inp.
+void
+getgens (Alphabet& A, istream* inp)
+{
+  const string rule = "an integer between 1 and " + to_string (MAXGENS)
+    + ", optionally followed by that many generator names";
   if (inp == &cin)
     cout << "Number of generators: ";
-  bool gotngens = (*inp >> n && n >=1 && n <= 26);
-  if (inp != &cin && !gotngens)
+  string line;
+  bool gotgens = getline (*inp, line) && parse_generators (line, A);
+  if (inp != &cin && !gotgens)
     {
-      cerr << "Number of generators must be an integer between 1 and 26.\n";
+      cerr << "The first line must be " << rule << ".\n";
       exit (EXIT_FAILURE);
     }
-  // Now n is valid, or else we're working interactively and n is
-  // invalid; in that case we retry after clearing cin and any invalid
-  // input.
-  while (!gotngens)
+  // Now the line is valid, or else we're working interactively and it
+  // is invalid; in that case we retry.
+  while (!gotgens)
     {
       cin.clear ();
-      char c;
-      while (cin.get (c) && c != '\n')
-	;
-      cout << "Please enter an integer between 1 and 26: ";
-      gotngens = (cin >> n && n >=1 && n <= 26);
+      cout << "Please enter " << rule << ": ";
+      gotgens = getline (cin, line) && parse_generators (line, A);
     }
-  // Read newline.
-  char c;
-  while (inp->get (c) && c != '\n')
-    ;
-  return n;
 }
 
 // Prompt for number of generators and group and subgroup info.
 void
-getgroup (int& NGENS, vector<string>& rel, vector<string>& gen_H, istream* inp)
+getgroup (Alphabet& A, vector<string>& rel, vector<string>& gen_H,
+	  istream* inp)
 {
-  NGENS = 2 * getngens (inp);		// NGENS counts inverses
+  getgens (A, inp);
   if (inp == &cin)
     cout <<
       "Enter the relators for G, one per line; press Enter when finished:\n> ";
-  getvecstringword (rel, NGENS, inp);
+  getvecstringword (rel, A, inp);
   if (inp == &cin)
     cout <<
       "Enter the generators of H, one per line; press Enter when finished:\n> ";
-  getvecstringword (gen_H, NGENS, inp);
+  getvecstringword (gen_H, A, inp);
 }
 
 void
@@ -191,3 +180,94 @@ rotate (string& s)
 {
   s = s.substr (1) + s[0];
 }
+
+word
+inverse (const word& w)
+{
+  word v;
+  for (int i = w.size () - 1; i >= 0; i--)
+    v.push_back (inv (w[i]));
+  return v;
+}
+
+// Cancel adjacent pairs x x^{-1}, in place.
+void
+free_reduce (word& w)
+{
+  int n = 0;			// w[0], ..., w[n-1] is reduced
+  for (size_t i = 0; i < w.size (); i++)
+    if (n > 0 && w[n - 1] == inv (w[i]))
+      n--;
+    else
+      w[n++] = w[i];
+  w.resize (n);
+}
+
+// Freely reduce w, then cancel the first letter against the last as
+// long as they are inverse to each other.  The result is conjugate to
+// the original word.
+void
+cyclically_reduce (word& w)
+{
+  free_reduce (w);
+  int b = 0, e = w.size ();
+  while (e - b >= 2 && w[b] == inv (w[e - 1]))
+    b++, e--;
+  w = word (w.begin () + b, w.begin () + e);
+}
+
+// The lexicographically least cyclic conjugate of w or of its
+// inverse.  Relators with the same canonical conjugate give exactly
+// the same scans, so only one of them is needed.
+word
+canonical_conjugate (const word& w)
+{
+  word best = w;
+  word r[2] = { w, inverse (w) };
+  for (int j = 0; j < 2; j++)
+    for (size_t i = 0; i < w.size (); i++)
+      {
+	best = min (best, r[j]);
+	std::rotate (r[j].begin (), r[j].begin () + 1, r[j].end ());
+      }
+  return best;
+}
+
+static bool
+shorter (const word& u, const word& v)
+{
+  return u.size () < v.size ();
+}
+
+// Reduce a presentation before enumeration: cyclically reduce the
+// relators, drop the empty ones and all but the first of any set that
+// agree up to cyclic conjugation and inversion, and sort the rest by
+// length (keeping the given order among relators of equal length), so
+// that the cheap scans come first.  Subgroup generators can only be
+// freely reduced; empty ones and repeats (up to inversion) are
+// dropped.
+void
+simplify_presentation (vector<word>& rel, vector<word>& gen_H)
+{
+  set<word> seen;
+  vector<word> r;
+  for (size_t i = 0; i < rel.size (); i++)
+    {
+      word w = rel[i];
+      cyclically_reduce (w);
+      if (!w.empty () && seen.insert (canonical_conjugate (w)).second)
+	r.push_back (w);
+    }
+  stable_sort (r.begin (), r.end (), shorter);
+  rel.swap (r);
+  seen.clear ();
+  vector<word> h;
+  for (size_t i = 0; i < gen_H.size (); i++)
+    {
+      word w = gen_H[i];
+      free_reduce (w);
+      if (!w.empty () && seen.insert (min (w, inverse (w))).second)
+	h.push_back (w);
+    }
+  gen_H.swap (h);
+}
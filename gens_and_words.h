@@ -28,23 +28,30 @@
 
 const int NOTAGEN = -1;
 
-/* generators (including inverses); they will be represented
-   internally by their index in the string gen */
-const std::string gens = "aAbBcCdDeEfFgGhHiIjJkKlLmMnNoOpPqQrRsStTuUvVwWxXyYzZ";
+/* The largest number of generators (not counting inverses). */
+const int MAXGENS = 1 << 14;
 
-int inv (int x);
+class Alphabet;
+
+/* Generator i is 2i and its inverse is 2i + 1. */
+inline int inv (int x) { return x ^ 1; }
 char switch_case (char);
 
 typedef std::vector<int> word;
 
-int char_to_gen (char c, int NGENS);
-bool string_to_word (word& w, const std::string& s, int NGENS);
-
-void getgroup (int& NGENS, std::vector<std::string>& rel,
+bool parse_generators (const std::string& line, Alphabet& A);
+void getgroup (Alphabet& A, std::vector<std::string>& rel,
 	       std::vector<std::string>& gen_H, std::istream* inp);
 
 void rotate (std::string& s);
 
+word inverse (const word& w);
+void free_reduce (word& w);
+void cyclically_reduce (word& w);
+word canonical_conjugate (const word& w);
+void simplify_presentation (std::vector<word>& rel,
+			    std::vector<word>& gen_H);
+
 
 
 #endif	/* GENS_AND_WORDS_H */
@@ -0,0 +1,142 @@
+/* kernbench.cc: timing the table kernels at each instruction set level.
+
+   Copyright 2012 Kenneth S. Brown.
+
+   This file is part of Toddcox.
+
+   Toddcox is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version (GPLv3+).
+
+   Toddcox is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Toddcox; if not, see <http://gnu.org/licenses/>.
+
+   Written by Ken Brown <kbrown@cornell.edu>. */
+
+// Time the kernels in kernels.cc at every instruction set level the
+// processor supports, on tables shaped like the largest ones that
+// arise for two of the examples (HLT on M12.in and SL2_13.in, whose
+// sizes are the maximum table sizes reported by toddcox --stats), or
+// on tables of the sizes given on the command line as ROWS COLUMNS
+// pairs.  The tables hold random coset numbers, with about one entry
+// in eight undefined.
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <stdint.h>
+#include <sys/time.h>
+#include "kernels.h"
+
+using namespace std;
+
+struct Shape
+{
+  const char* name;
+  long rows;
+  int cols;
+};
+
+// Keeps the counts from being optimized away.
+static volatile long sink;
+
+static double
+now ()
+{
+  struct timeval t;
+  gettimeofday (&t, 0);
+  return t.tv_sec + t.tv_usec / 1e6;
+}
+
+// Average time in milliseconds of calls to f, repeated for at least
+// a quarter of a second.
+template <class F>
+static double
+time_ms (F f)
+{
+  int reps = 0;
+  const double start = now ();
+  double elapsed;
+  do
+    {
+      f ();
+      reps++;
+    }
+  while ((elapsed = now () - start) < 0.25);
+  return 1000 * elapsed / reps;
+}
+
+static void
+bench (const Shape& s)
+{
+  vector<int32_t> p (s.rows), tab (s.rows * s.cols), newnum (s.rows);
+  srand (1);
+  for (long k = 0; k < s.rows; k++)
+    {
+      p[k] = (rand () % 2 ? k : rand () % (k + 1));
+      newnum[k] = k;
+    }
+  for (long k = s.rows - 1; k > 0; k--)
+    swap (newnum[k], newnum[rand () % (k + 1)]);
+  for (size_t i = 0; i < tab.size (); i++)
+    tab[i] = (rand () % 8 == 0 ? -1 : rand () % s.rows);
+  cout << s.name << ": " << s.rows << " rows, " << s.cols
+       << " columns, 32-bit entries\n";
+  double base[2];
+  const int best = set_kernel_level (KERNELS_AVX2);
+  for (int level = KERNELS_SCALAR; level <= best; level++)
+    {
+      set_kernel_level (level);
+      double t[2];
+      t[0] = time_ms ([&] { sink = count_fixed_points (&p[0], s.rows); });
+      t[1] = time_ms ([&] { remap (&tab[0], tab.size (), &newnum[0]); });
+      if (level == KERNELS_SCALAR)
+	copy (t, t + 2, base);
+      cout << "  " << setw (7) << left << kernel_level_name (level)
+	   << right << fixed << setprecision (3)
+	   << "count_fixed_points " << setw (9) << t[0] << " ms ("
+	   << setprecision (2) << base[0] / t[0] << "x)   "
+	   << setprecision (3)
+	   << "remap " << setw (9) << t[1] << " ms ("
+	   << setprecision (2) << base[1] / t[1] << "x)\n";
+    }
+}
+
+static void
+usage (const char* progname)
+{
+  cerr << "Usage: " << progname << " [ROWS COLUMNS]...\n";
+  exit (1);
+}
+
+int
+main (int argc, char *argv[])
+{
+  vector<Shape> shapes;
+  if (argc % 2 == 0)
+    usage (argv[0]);
+  for (int i = 1; i < argc; i += 2)
+    {
+      Shape s = {"table", atol (argv[i]), atoi (argv[i + 1])};
+      if (s.rows <= 0 || s.cols <= 0)
+	usage (argv[0]);
+      shapes.push_back (s);
+    }
+  if (shapes.empty ())
+    {
+      Shape m12 = {"M12", 550794, 6}, sl2 = {"SL2_13", 28982972, 4};
+      shapes.push_back (m12);
+      shapes.push_back (sl2);
+    }
+  for (size_t i = 0; i < shapes.size (); i++)
+    bench (shapes[i]);
+  return 0;
+}
@@ -0,0 +1,314 @@
+/* kernels.cc: vectorized passes over arrays of coset numbers.
+
+   Copyright 2012 Kenneth S. Brown.
+
+   This file is part of Toddcox.
+
+   Toddcox is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version (GPLv3+).
+
+   Toddcox is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Toddcox; if not, see <http://gnu.org/licenses/>.
+
+   Written by Ken Brown <kbrown@cornell.edu>. */
+
+#include <stdint.h>
+
+#include "kernels.h"
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+static int
+best_kernel_level ()
+{
+#ifdef X86_KERNELS
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2"))
+    return KERNELS_AVX2;
+  if (__builtin_cpu_supports ("sse2"))
+    return KERNELS_SSE2;
+#endif
+  return KERNELS_SCALAR;
+}
+
+// The level in use.  It is set once, before any kernel runs, unless
+// set_kernel_level is called (which should happen before any other
+// threads start).
+static int&
+level ()
+{
+  static int l = best_kernel_level ();
+  return l;
+}
+
+int
+kernel_level ()
+{
+  return level ();
+}
+
+int
+set_kernel_level (int l)
+{
+  const int best = best_kernel_level ();
+  level () = (l < best ? l : best);
+  return level ();
+}
+
+const char*
+kernel_level_name (int l)
+{
+  switch (l)
+    {
+    case KERNELS_AVX2:
+      return "avx2";
+    case KERNELS_SSE2:
+      return "sse2";
+    default:
+      return "scalar";
+    }
+}
+
+// Plain loops, for any type, starting at i.
+
+template <class T>
+static long
+count_scalar (const T* p, long i, long n)
+{
+  long count = 0;
+  for (; i < n; i++)
+    if (p[i] == i)
+      count++;
+  return count;
+}
+
+template <class T>
+static void
+remap_scalar (T* a, long i, long n, const T* newnum)
+{
+  for (; i < n; i++)
+    if (a[i] >= 0)
+      a[i] = newnum[a[i]];
+}
+
+#ifdef X86_KERNELS
+
+// The counts keep one counter per lane, subtracting the all-ones mask
+// of each match.  A lane sees at most n / (number of lanes) matches,
+// which fits in the lane because n fits in T.
+
+template <class T>
+static long
+sum_lanes (const T* lanes, int nlanes)
+{
+  long count = 0;
+  for (int j = 0; j < nlanes; j++)
+    count += lanes[j];
+  return count;
+}
+
+__attribute__ ((target ("sse2")))
+static long
+count_sse2 (const int16_t* p, long n)
+{
+  __m128i idx = _mm_setr_epi16 (0, 1, 2, 3, 4, 5, 6, 7);
+  const __m128i step = _mm_set1_epi16 (8);
+  __m128i acc = _mm_setzero_si128 ();
+  long i = 0;
+  for (; i + 8 <= n; i += 8)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i*) (p + i));
+      acc = _mm_sub_epi16 (acc, _mm_cmpeq_epi16 (v, idx));
+      idx = _mm_add_epi16 (idx, step);
+    }
+  uint16_t lanes[8];
+  _mm_storeu_si128 ((__m128i*) lanes, acc);
+  return sum_lanes (lanes, 8) + count_scalar (p, i, n);
+}
+
+__attribute__ ((target ("sse2")))
+static long
+count_sse2 (const int32_t* p, long n)
+{
+  __m128i idx = _mm_setr_epi32 (0, 1, 2, 3);
+  const __m128i step = _mm_set1_epi32 (4);
+  __m128i acc = _mm_setzero_si128 ();
+  long i = 0;
+  for (; i + 4 <= n; i += 4)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i*) (p + i));
+      acc = _mm_sub_epi32 (acc, _mm_cmpeq_epi32 (v, idx));
+      idx = _mm_add_epi32 (idx, step);
+    }
+  uint32_t lanes[4];
+  _mm_storeu_si128 ((__m128i*) lanes, acc);
+  return sum_lanes (lanes, 4) + count_scalar (p, i, n);
+}
+
+__attribute__ ((target ("avx2")))
+static long
+count_avx2 (const int16_t* p, long n)
+{
+  __m256i idx = _mm256_setr_epi16 (0, 1, 2, 3, 4, 5, 6, 7,
+				   8, 9, 10, 11, 12, 13, 14, 15);
+  const __m256i step = _mm256_set1_epi16 (16);
+  __m256i acc = _mm256_setzero_si256 ();
+  long i = 0;
+  for (; i + 16 <= n; i += 16)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i*) (p + i));
+      acc = _mm256_sub_epi16 (acc, _mm256_cmpeq_epi16 (v, idx));
+      idx = _mm256_add_epi16 (idx, step);
+    }
+  uint16_t lanes[16];
+  _mm256_storeu_si256 ((__m256i*) lanes, acc);
+  return sum_lanes (lanes, 16) + count_scalar (p, i, n);
+}
+
+__attribute__ ((target ("avx2")))
+static long
+count_avx2 (const int32_t* p, long n)
+{
+  __m256i idx = _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7);
+  const __m256i step = _mm256_set1_epi32 (8);
+  __m256i acc = _mm256_setzero_si256 ();
+  long i = 0;
+  for (; i + 8 <= n; i += 8)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i*) (p + i));
+      acc = _mm256_sub_epi32 (acc, _mm256_cmpeq_epi32 (v, idx));
+      idx = _mm256_add_epi32 (idx, step);
+    }
+  uint32_t lanes[8];
+  _mm256_storeu_si256 ((__m256i*) lanes, acc);
+  return sum_lanes (lanes, 8) + count_scalar (p, i, n);
+}
+
+__attribute__ ((target ("avx2")))
+static long
+count_avx2 (const int64_t* p, long n)
+{
+  __m256i idx = _mm256_setr_epi64x (0, 1, 2, 3);
+  const __m256i step = _mm256_set1_epi64x (4);
+  __m256i acc = _mm256_setzero_si256 ();
+  long i = 0;
+  for (; i + 4 <= n; i += 4)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i*) (p + i));
+      acc = _mm256_sub_epi64 (acc, _mm256_cmpeq_epi64 (v, idx));
+      idx = _mm256_add_epi64 (idx, step);
+    }
+  uint64_t lanes[4];
+  _mm256_storeu_si256 ((__m256i*) lanes, acc);
+  return sum_lanes (lanes, 4) + count_scalar (p, i, n);
+}
+
+// remap gathers the new numbers of the defined entries; undefined
+// entries are masked off and keep their value.  There are no gathers
+// before AVX2, and none of 16-bit elements.
+
+__attribute__ ((target ("avx2")))
+static void
+remap_avx2 (int32_t* a, long n, const int32_t* newnum)
+{
+  const __m256i none = _mm256_set1_epi32 (-1);
+  long i = 0;
+  for (; i + 8 <= n; i += 8)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i*) (a + i));
+      __m256i defined = _mm256_cmpgt_epi32 (v, none);
+      v = _mm256_mask_i32gather_epi32 (v, (const int*) newnum, v, defined, 4);
+      _mm256_storeu_si256 ((__m256i*) (a + i), v);
+    }
+  remap_scalar (a, i, n, newnum);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+remap_avx2 (int64_t* a, long n, const int64_t* newnum)
+{
+  const __m256i none = _mm256_set1_epi64x (-1);
+  long i = 0;
+  for (; i + 4 <= n; i += 4)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i*) (a + i));
+      __m256i defined = _mm256_cmpgt_epi64 (v, none);
+      v = _mm256_mask_i64gather_epi64 (v, (const long long*) newnum, v,
+				       defined, 8);
+      _mm256_storeu_si256 ((__m256i*) (a + i), v);
+    }
+  remap_scalar (a, i, n, newnum);
+}
+
+#endif	/* X86_KERNELS */
+
+long
+count_fixed_points (const int16_t* p, long n)
+{
+#ifdef X86_KERNELS
+  if (level () == KERNELS_AVX2)
+    return count_avx2 (p, n);
+  if (level () == KERNELS_SSE2)
+    return count_sse2 (p, n);
+#endif
+  return count_scalar (p, 0, n);
+}
+
+long
+count_fixed_points (const int32_t* p, long n)
+{
+#ifdef X86_KERNELS
+  if (level () == KERNELS_AVX2)
+    return count_avx2 (p, n);
+  if (level () == KERNELS_SSE2)
+    return count_sse2 (p, n);
+#endif
+  return count_scalar (p, 0, n);
+}
+
+// SSE2 can't compare 64-bit lanes.
+long
+count_fixed_points (const int64_t* p, long n)
+{
+#ifdef X86_KERNELS
+  if (level () == KERNELS_AVX2)
+    return count_avx2 (p, n);
+#endif
+  return count_scalar (p, 0, n);
+}
+
+void
+remap (int16_t* a, long n, const int16_t* newnum)
+{
+  remap_scalar (a, 0, n, newnum);
+}
+
+void
+remap (int32_t* a, long n, const int32_t* newnum)
+{
+#ifdef X86_KERNELS
+  if (level () == KERNELS_AVX2)
+    return remap_avx2 (a, n, newnum);
+#endif
+  remap_scalar (a, 0, n, newnum);
+}
+
+void
+remap (int64_t* a, long n, const int64_t* newnum)
+{
+#ifdef X86_KERNELS
+  if (level () == KERNELS_AVX2)
+    return remap_avx2 (a, n, newnum);
+#endif
+  remap_scalar (a, 0, n, newnum);
+}
@@ -0,0 +1,59 @@
+/* kernels.h: vectorized passes over arrays of coset numbers.
+
+   Copyright 2012 Kenneth S. Brown.
+
+   This file is part of Toddcox.
+
+   Toddcox is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version (GPLv3+).
+
+   Toddcox is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Toddcox; if not, see <http://gnu.org/licenses/>.
+
+   Written by Ken Brown <kbrown@cornell.edu>. */
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stdint.h>
+
+/* Some passes touch a whole array of coset numbers in order: counting
+   the live cosets, and renumbering every entry of the table when it
+   is compressed or standardized.  These kernels do such passes with
+   SSE2 or AVX2 instructions when the processor has them, and with
+   plain loops otherwise.  The instruction set is chosen at run time,
+   the first time a kernel is called, so one executable runs well on
+   any x86 processor; on other processors the plain loops are used.
+
+   count_fixed_points returns the number of i < n with p[i] == i; n
+   must not exceed the largest value of the type, plus 1.
+
+   remap replaces each entry a[i] >= 0, for i < n, by newnum[a[i]],
+   leaving negative (undefined) entries alone. */
+
+long count_fixed_points (const int16_t* p, long n);
+long count_fixed_points (const int32_t* p, long n);
+long count_fixed_points (const int64_t* p, long n);
+void remap (int16_t* a, long n, const int16_t* newnum);
+void remap (int32_t* a, long n, const int32_t* newnum);
+void remap (int64_t* a, long n, const int64_t* newnum);
+
+/* The instruction sets the kernels can use, from least to most
+   capable.  set_kernel_level is for testing and benchmarking; it
+   chooses the given level, or the best one the processor supports if
+   that is lower, and returns the level chosen. */
+
+enum KernelLevel {KERNELS_SCALAR, KERNELS_SSE2, KERNELS_AVX2};
+
+int kernel_level ();
+int set_kernel_level (int level);
+const char* kernel_level_name (int level);
+
+#endif	/* KERNELS_H */
@@ -0,0 +1,477 @@
+/* lowindex.cc: implementation of the LowIndex class.
+
+   Copyright 2012 Kenneth S. Brown.
+
+   This file is part of Toddcox.
+
+   Toddcox is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version (GPLv3+).
+
+   Toddcox is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Toddcox; if not, see <http://gnu.org/licenses/>.
+
+   Written by Ken Brown <kbrown@cornell.edu>. */
+
+#include <vector>
+#include <string>
+#include <set>
+#include <algorithm>
+#include <mutex>
+#include <utility>
+
+#include "lowindex.h"
+#include "gens_and_words.h"
+#include "alphabet.h"
+#include "relindex.h"
+#include "workerpool.h"
+
+using namespace std;
+
+// The state of one thread's search: a partial coset table, with a
+// trail of the entries defined so far, so that a branch can be undone.
+class LowIndex::Search
+{
+ public:
+  explicit Search (LowIndex& l);
+  void start (const Node& node);
+  bool close ();
+  void descend (int e);
+  Node node (int next) const;
+  unsigned long nodes;		/* calls to descend */
+ private:
+  LowIndex& li;
+  const int NGENS;
+  vector<int> tab;
+  int n;			/* cosets in use */
+  vector<int> trail;		/* entries defined, in order */
+  vector< pair<int, int> > deductions; /* (c, x) still to follow up */
+  vector<int> label;		/* scratch for compare */
+  vector<unsigned> stamp;	/* label[c] is valid if stamp[c] == now */
+  vector<int> order;
+  unsigned now;
+  int& entry (int c, int x) { return tab[c * NGENS + x]; }
+  int entry (int c, int x) const { return tab[c * NGENS + x]; }
+  void define (int c, int x, int d);
+  bool scan (int k, const int* w, int len);
+  bool closes (int k, const word& w) const;
+  bool eligible (int b) const;
+  int compare (int b);
+  bool canonical ();
+  bool try_branch (int c, int x, int d);
+  void undo (size_t mark, int n0);
+  void give_away (int e, int d);
+  void report ();
+};
+
+LowIndex::Search::Search (LowIndex& l)
+  : nodes (0), li (l), NGENS (l.NGENS), tab (l.maxindex * l.NGENS, -1),
+    n (1), label (l.maxindex), stamp (l.maxindex, 0), now (0)
+{
+}
+
+void
+LowIndex::Search::start (const Node& node)
+{
+  tab = node.table;
+  n = node.n;
+  trail.clear ();
+  deductions.clear ();
+}
+
+LowIndex::Node
+LowIndex::Search::node (int next) const
+{
+  Node nd;
+  nd.table = tab;
+  nd.n = n;
+  nd.next = next;
+  return nd;
+}
+
+// Set coset c acted on by x to be d, and queue the deduction.
+void
+LowIndex::Search::define (int c, int x, int d)
+{
+  entry (c, x) = d;
+  entry (d, inv (x)) = c;
+  trail.push_back (c * NGENS + x);
+  trail.push_back (d * NGENS + inv (x));
+  deductions.push_back (make_pair (c, x));
+}
+
+// Scan w at k as in CosetTable::scan, defining the missing entry if
+// there is just one.  Return false on a coincidence.
+bool
+LowIndex::Search::scan (int k, const int* w, int len)
+{
+  int i = 0, j = len - 1;
+  int f = k, b = k;
+  while (i <= j && entry (f, w[i]) >= 0)
+    f = entry (f, w[i++]);
+  if (i > j)
+    return f == k;
+  while (j >= i && entry (b, inv (w[j])) >= 0)
+    b = entry (b, inv (w[j--]));
+  if (j < i)
+    return f == b;
+  if (j == i)
+    define (f, w[i], b);
+  return true;
+}
+
+// Follow up the deductions, as in CosetTable::process_deductions,
+// and scan the generators of H at coset 0, until nothing more can be
+// deduced.  Return false on a coincidence.
+bool
+LowIndex::Search::close ()
+{
+  const RelatorIndex& conj = li.conjugates;
+  for (;;)
+    {
+      while (!deductions.empty ())
+	{
+	  int k = deductions.back ().first;
+	  int x = deductions.back ().second;
+	  deductions.pop_back ();
+	  for (int i = conj.begin (x); i < conj.end (x); i++)
+	    if (!scan (k, conj.letters (i), conj.length (i)))
+	      return false;
+	  k = entry (k, x);
+	  x = inv (x);
+	  for (int i = conj.begin (x); i < conj.end (x); i++)
+	    if (!scan (k, conj.letters (i), conj.length (i)))
+	      return false;
+	}
+      for (size_t i = 0; i < li.generator_of_H.size (); i++)
+	{
+	  const word& w = li.generator_of_H[i];
+	  if (!scan (0, w.data (), w.size ()))
+	    return false;
+	}
+      if (deductions.empty ())
+	return true;
+    }
+}
+
+// Is w known to hold at coset k?
+bool
+LowIndex::Search::closes (int k, const word& w) const
+{
+  int f = k;
+  for (size_t i = 0; i < w.size (); i++)
+    if ((f = entry (f, w[i])) < 0)
+      return false;
+  return f == k;
+}
+
+// Is H known to lie in the stabilizer of coset b?  Only then does
+// renumbering from b give a table of a conjugate containing H.
+bool
+LowIndex::Search::eligible (int b) const
+{
+  for (size_t i = 0; i < li.generator_of_H.size (); i++)
+    if (!closes (b, li.generator_of_H[i]))
+      return false;
+  return true;
+}
+
+// Compare the table renumbered starting from coset b, and
+// standardized, with the table itself, entry by entry in row order as
+// far as both are defined.  Return -1 if the renumbered table is
+// smaller, 1 if it is bigger, and 0 if they agree that far.
+int
+LowIndex::Search::compare (int b)
+{
+  now++;
+  order.clear ();
+  label[b] = 0;
+  stamp[b] = now;
+  order.push_back (b);
+  for (size_t r = 0; r < order.size (); r++)
+    for (int x = 0; x < NGENS; x++)
+      {
+	const int o = entry (r, x), e = entry (order[r], x);
+	if (o < 0 || e < 0)
+	  return 0;
+	if (stamp[e] != now)
+	  {
+	    stamp[e] = now;
+	    label[e] = order.size ();
+	    order.push_back (e);
+	  }
+	if (label[e] != o)
+	  return label[e] < o ? -1 : 1;
+      }
+  return 0;
+}
+
+// Could the table still be the smallest of those of its conjugates
+// that contain H?
+bool
+LowIndex::Search::canonical ()
+{
+  for (int b = 1; b < n; b++)
+    if (eligible (b) && compare (b) < 0)
+      return false;
+  return true;
+}
+
+// Define coset c acted on by x to be d, a new coset if d == n, and
+// follow up.  Return false if the branch can be pruned.  In any case
+// the caller undoes the definition when done with the branch.
+bool
+LowIndex::Search::try_branch (int c, int x, int d)
+{
+  if (d == n)
+    n++;
+  define (c, x, d);
+  return close () && canonical ();
+}
+
+void
+LowIndex::Search::undo (size_t mark, int n0)
+{
+  while (trail.size () > mark)
+    {
+      tab[trail.back ()] = -1;
+      trail.pop_back ();
+    }
+  n = n0;
+  deductions.clear ();
+}
+
+// Search the subtree below the current table, whose entries before e
+// are all defined.
+void
+LowIndex::Search::descend (int e)
+{
+  nodes++;
+  const int end = n * NGENS;
+  while (e < end && tab[e] >= 0)
+    e++;
+  if (e == end)
+    {
+      report ();
+      return;
+    }
+  const int c = e / NGENS, x = e % NGENS;
+  for (int d = 0; d <= n && d < li.maxindex; d++)
+    {
+      if (d < n && entry (d, inv (x)) >= 0)
+	continue;
+      if (li.idle > li.npending)
+	{
+	  give_away (e, d);
+	  return;
+	}
+      const size_t mark = trail.size ();
+      const int n0 = n;
+      if (try_branch (c, x, d))
+	descend (e + 1);
+      undo (mark, n0);
+    }
+}
+
+// Hand the branches d, d+1, ... at entry e over to the idle threads.
+void
+LowIndex::Search::give_away (int e, int d)
+{
+  const int c = e / NGENS, x = e % NGENS;
+  vector<Node> v;
+  for (; d <= n && d < li.maxindex; d++)
+    {
+      if (d < n && entry (d, inv (x)) >= 0)
+	continue;
+      const size_t mark = trail.size ();
+      const int n0 = n;
+      if (try_branch (c, x, d))
+	v.push_back (node (e + 1));
+      undo (mark, n0);
+    }
+  if (v.empty ())
+    return;
+  {
+    lock_guard<mutex> lock (li.m);
+    for (size_t i = 0; i < v.size (); i++)
+      li.pending.push_back (move (v[i]));
+    li.npending = li.pending.size ();
+  }
+  li.work.notify_all ();
+}
+
+// Record the complete table.  The subgroup is normal if the table is
+// the same whichever coset it is renumbered from.
+void
+LowIndex::Search::report ()
+{
+  Subgroup K;
+  K.index = n;
+  K.normal = true;
+  for (int b = 1; b < n && K.normal; b++)
+    K.normal = (eligible (b) && compare (b) == 0);
+  K.table.assign (tab.begin (), tab.begin () + n * NGENS);
+  lock_guard<mutex> lock (li.m);
+  li.found.push_back (move (K));
+}
+
+LowIndex::LowIndex (const Alphabet& A, const vector<string>& rel,
+		    const vector<string>& gen_H, int maxindex)
+  : alphabet (A), NGENS (A.size ()), maxindex (maxindex), nnodes (0),
+    nthreads (1), idle (0), npending (0)
+{
+  vector<word> relator;
+  for (size_t i = 0; i < rel.size (); i++)
+    {
+      word w;
+      alphabet.string_to_word (w, rel[i]);
+      relator.push_back (w);
+    }
+  for (size_t i = 0; i < gen_H.size (); i++)
+    {
+      word w;
+      alphabet.string_to_word (w, gen_H[i]);
+      generator_of_H.push_back (w);
+    }
+  simplify_presentation (relator, generator_of_H);
+  // All cyclic conjugates of the relators and their inverses, as for
+  // the Felsch method in CosetTable.
+  vector<word> W;
+  set<word> seen;
+  for (size_t i = 0; i < relator.size (); i++)
+    {
+      word r[2] = { relator[i], inverse (relator[i]) };
+      for (size_t j = 0; j < relator[i].size (); j++)
+	for (int e = 0; e < 2; e++)
+	  {
+	    if (seen.insert (r[e]).second)
+	      W.push_back (r[e]);
+	    std::rotate (r[e].begin (), r[e].begin () + 1, r[e].end ());
+	  }
+    }
+  conjugates.build (NGENS, W);
+}
+
+static bool
+before (const LowIndex::Subgroup& K, const LowIndex::Subgroup& L)
+{
+  if (K.index != L.index)
+    return K.index < L.index;
+  return K.table < L.table;
+}
+
+void
+LowIndex::search (int nthreads)
+{
+  found.clear ();
+  pending.clear ();
+  nnodes = 0;
+  if (maxindex < 1)
+    return;
+  {
+    Search s (*this);
+    if (s.close ())
+      pending.push_back (s.node (0));
+  }
+  npending = pending.size ();
+  idle = 0;
+  WorkerPool pool (nthreads);
+  this->nthreads = pool.size ();
+  pool.run (pool.size (), [&] (int) { worker (); });
+  sort (found.begin (), found.end (), before);
+}
+
+// Take subtrees from pending and search them, until pending is empty
+// and every thread is idle.
+void
+LowIndex::worker ()
+{
+  Search s (*this);
+  for (;;)
+    {
+      Node node;
+      {
+	unique_lock<mutex> lock (m);
+	if (++idle == nthreads && pending.empty ())
+	  work.notify_all ();
+	work.wait (lock, [&]
+	  { return !pending.empty () || idle == nthreads; });
+	if (pending.empty ())
+	  break;
+	--idle;
+	node = move (pending.front ());
+	pending.pop_front ();
+	npending = pending.size ();
+      }
+      s.start (node);
+      s.descend (node.next);
+    }
+  lock_guard<mutex> lock (m);
+  nnodes += s.nodes;
+}
+
+// Each entry of the table that isn't in the spanning tree of coset
+// representatives (the first entry leading to each coset in row
+// order, and its inverse) gives a Schreier generator rep (c) x
+// rep (c x)^-1.  Only one of each such entry and its inverse is
+// used.
+vector<word>
+LowIndex::generators (const Subgroup& K) const
+{
+  const int n = K.index;
+  vector<word> rep (n);
+  vector<bool> reached (n, false), tree (n * NGENS, false);
+  reached[0] = true;
+  for (int c = 0; c < n; c++)
+    for (int x = 0; x < NGENS; x++)
+      {
+	const int d = K.table[c * NGENS + x];
+	if (!reached[d])
+	  {
+	    reached[d] = true;
+	    rep[d] = rep[c];
+	    rep[d].push_back (x);
+	    tree[c * NGENS + x] = tree[d * NGENS + inv (x)] = true;
+	  }
+      }
+  vector<word> gens;
+  set<word> seen;
+  for (int c = 0; c < n; c++)
+    for (int x = 0; x < NGENS; x++)
+      {
+	const int d = K.table[c * NGENS + x];
+	if (tree[c * NGENS + x] || d * NGENS + inv (x) < c * NGENS + x)
+	  continue;
+	word w = rep[c];
+	w.push_back (x);
+	const word v = inverse (rep[d]);
+	w.insert (w.end (), v.begin (), v.end ());
+	free_reduce (w);
+	if (!w.empty () && seen.insert (min (w, inverse (w))).second)
+	  gens.push_back (w);
+      }
+  return gens;
+}
+
+void
+LowIndex::print (ostream& os) const
+{
+  os << "# index\tnormal\tgenerators\n";
+  for (size_t i = 0; i < found.size (); i++)
+    {
+      const Subgroup& K = found[i];
+      os << K.index << "\t" << (K.normal ? "yes" : "no") << "\t";
+      vector<word> gens = generators (K);
+      if (gens.empty ())
+	os << "-";
+      for (size_t j = 0; j < gens.size (); j++)
+	os << (j > 0 ? "," : "") << alphabet.word_to_string (gens[j]);
+      os << "\n";
+    }
+}
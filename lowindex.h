@@ -0,0 +1,110 @@
+/* lowindex.h: declarations for the LowIndex class.
+
+   Copyright 2012 Kenneth S. Brown.
+
+   This file is part of Toddcox.
+
+   Toddcox is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version (GPLv3+).
+
+   Toddcox is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Toddcox; if not, see <http://gnu.org/licenses/>.
+
+   Written by Ken Brown <kbrown@cornell.edu>. */
+
+#ifndef LOWINDEX_H
+#define LOWINDEX_H
+
+#include <vector>
+#include <string>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <iostream>
+
+#include "gens_and_words.h"
+#include "alphabet.h"
+#include "relindex.h"
+
+/* A LowIndex finds the subgroups of index at most maxindex in a
+   finitely presented group G that contain the subgroup H generated by
+   gen_H, one from each conjugacy class.  A subgroup K of index n is
+   given by the action of G on its cosets, i.e., by a complete coset
+   table with n rows, and the search (Sims, Computation with finitely
+   presented groups, Section 5.6) runs over partial coset tables with
+   at most maxindex rows.  At each step the first undefined entry in
+   row order is defined in every possible way: as each existing coset
+   whose inverse entry is free, or as a new coset.  The deductions are
+   followed up as in the Felsch method, by scanning the cyclic
+   conjugates of the relators, and the words of gen_H at coset 0.  A
+   coincidence means there is no such subgroup down that branch.
+
+   Defining entries in row order keeps every table standardized (see
+   CosetTable::standardize), so each subgroup is found once.  To find
+   each conjugacy class once, a table is kept only if renumbering its
+   cosets starting from some other coset (at which H also lies in the
+   stabilizer) doesn't give a smaller standardized table.  This is
+   checked for partial tables as far as they go, which prunes most of
+   the search.
+
+   search uses nthreads threads.  Each explores subtrees of the search
+   on its own; whenever some thread is idle, a busy one hands over the
+   remaining branches at its current node.  subgroups returns the
+   results sorted by index and then by table, so they don't depend on
+   the number of threads. */
+
+class LowIndex
+{
+ public:
+  struct Subgroup
+  {
+    int index;
+    bool normal;
+    std::vector<int> table;	/* table[c * size () + x] */
+  };
+  LowIndex (const Alphabet& A, const std::vector<std::string>& rel,
+	    const std::vector<std::string>& gen_H, int maxindex);
+  void search (int nthreads);
+  int size () const { return NGENS; }
+  const std::vector<Subgroup>& subgroups () const { return found; }
+  unsigned long nodes () const { return nnodes; }
+  /* Schreier generators of K, freely reduced. */
+  std::vector<word> generators (const Subgroup& K) const;
+  /* One tab-separated line per subgroup: index, normal (yes or no)
+     and generators (as in a batch manifest). */
+  void print (std::ostream& os) const;
+ private:
+  LowIndex (const LowIndex&);
+  LowIndex& operator= (const LowIndex&);
+  class Search;
+  struct Node			/* a subtree handed to another thread */
+  {
+    std::vector<int> table;
+    int n;			/* cosets in use */
+    int next;			/* entries before this are defined */
+  };
+  Alphabet alphabet;
+  int NGENS;
+  int maxindex;
+  std::vector<word> generator_of_H;
+  RelatorIndex conjugates;
+  std::vector<Subgroup> found;
+  unsigned long nnodes;		/* nodes of the search tree visited */
+  std::mutex m;			/* protects the following */
+  std::condition_variable work;
+  std::deque<Node> pending;
+  int nthreads;
+  std::atomic<int> idle;	/* threads waiting for a Node */
+  std::atomic<int> npending;	/* pending.size () */
+  void worker ();
+};
+
+#endif	/* LOWINDEX_H */
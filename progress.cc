@@ -0,0 +1,55 @@
+/* progress.cc: implementation of the Progress class.
+
+   Copyright 2012 Kenneth S. Brown.
+
+   This file is part of Toddcox.
+
+   Toddcox is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version (GPLv3+).
+
+   Toddcox is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Toddcox; if not, see <http://gnu.org/licenses/>.
+
+   Written by Ken Brown <kbrown@cornell.edu>. */
+
+#include "progress.h"
+
+using namespace std;
+
+void
+Progress::start (ostream* o, int seconds)
+{
+  os = o;
+  interval = seconds;
+  restart (0);
+}
+
+void
+Progress::restart (unsigned long defined)
+{
+  ncalls = 0;
+  begin = last = time (0);
+  next = begin + interval;
+  last_defined = defined;
+}
+
+void
+Progress::report (long current, long size, long live, unsigned long defined)
+{
+  const time_t now = time (0);
+  const double rate = double (defined - last_defined) / (now - last);
+  *os << "[" << now - begin << "s] coset " << current + 1
+      << ", table size " << size << ", live " << live
+      << ", defined " << defined << " (" << (unsigned long) rate
+      << "/s)" << endl;
+  last = now;
+  last_defined = defined;
+  next = now + interval;
+}
@@ -0,0 +1,55 @@
+/* progress.h: declarations for the Progress class.
+
+   Copyright 2012 Kenneth S. Brown.
+
+   This file is part of Toddcox.
+
+   Toddcox is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version (GPLv3+).
+
+   Toddcox is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Toddcox; if not, see <http://gnu.org/licenses/>.
+
+   Written by Ken Brown <kbrown@cornell.edu>. */
+
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <iostream>
+#include <ctime>
+
+/* Periodic progress reports for long enumerations.  The main loops
+   call due () once per coset processed; it only looks at the clock
+   every CHECK_EVERY calls, so it is cheap enough to leave in.  When
+   due () returns true, the caller passes the current state to
+   report (), which writes a one-line summary. */
+
+class Progress
+{
+ public:
+  Progress () : os (0), interval (0), ncalls (0) {}
+  // Report every seconds seconds on *o, or never if o is 0.
+  void start (std::ostream* o, int seconds);
+  // Time the reports from now, with defined cosets already defined,
+  // e.g., after resuming from a checkpoint.
+  void restart (unsigned long defined);
+  bool due ()
+  { return os && (++ncalls % CHECK_EVERY) == 0 && time (0) >= next; }
+  void report (long current, long size, long live, unsigned long defined);
+ private:
+  enum {CHECK_EVERY = 4096};
+  std::ostream* os;
+  int interval;
+  unsigned long ncalls;
+  time_t begin, last, next;
+  unsigned long last_defined;
+};
+
+#endif	/* PROGRESS_H */
@@ -0,0 +1,51 @@
+/* relindex.cc: the RelatorIndex class.
+
+   Copyright 2011 Kenneth S. Brown.
+
+   This file is part of Toddcox.
+
+   Toddcox is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version (GPLv3+).
+
+   Toddcox is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Toddcox; if not, see <http://gnu.org/licenses/>.
+
+   Written by Ken Brown <kbrown@cornell.edu>. */
+
+#include <vector>
+
+#include "relindex.h"
+#include "gens_and_words.h"
+
+using namespace std;
+
+// Build the index from the nonempty words in w, keeping words with
+// the same first letter in their original order.
+void
+RelatorIndex::build (int NGENS, const vector<word>& w)
+{
+  packed.clear ();
+  start.clear ();
+  first.assign (NGENS + 1, 0);
+  for (size_t i = 0; i < w.size (); i++)
+    if (!w[i].empty ())
+      first[w[i][0] + 1]++;
+  for (int x = 0; x < NGENS; x++)
+    first[x + 1] += first[x];
+  // Lay out the words of each group in turn.
+  start.push_back (0);
+  for (int x = 0; x < NGENS; x++)
+    for (size_t i = 0; i < w.size (); i++)
+      if (!w[i].empty () && w[i][0] == x)
+	{
+	  packed.insert (packed.end (), w[i].begin (), w[i].end ());
+	  start.push_back (packed.size ());
+	}
+}
@@ -0,0 +1,53 @@
+/* relindex.h: declarations for the RelatorIndex class.
+
+   Copyright 2011 Kenneth S. Brown.
+
+   This file is part of Toddcox.
+
+   Toddcox is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version (GPLv3+).
+
+   Toddcox is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Toddcox; if not, see <http://gnu.org/licenses/>.
+
+   Written by Ken Brown <kbrown@cornell.edu>. */
+
+#ifndef RELINDEX_H
+#define RELINDEX_H
+
+#include <vector>
+
+#include "gens_and_words.h"
+
+/* A RelatorIndex is a read-only list of words, grouped according to
+   their first letter and packed into a single array of letters.  The
+   words starting with generator x are numbered from begin (x) up to
+   (but not including) end (x), and word i occupies the letters
+   letters (i)[0], ..., letters (i)[length (i) - 1].  The Felsch
+   algorithm uses it to find all cyclic conjugates of relators and
+   their inverses that start with a given generator, without copying
+   or allocating anything. */
+
+class RelatorIndex
+{
+ public:
+  RelatorIndex () {}
+  void build (int NGENS, const std::vector<word>& w);
+  int begin (int x) const { return first[x]; }
+  int end (int x) const { return first[x + 1]; }
+  const int* letters (int i) const { return &packed[start[i]]; }
+  int length (int i) const { return start[i + 1] - start[i]; }
+ private:
+  std::vector<int> packed;	/* all letters, word after word */
+  std::vector<int> start;	/* word i starts at packed[start[i]] */
+  std::vector<int> first;	/* words starting with x are first[x],... */
+};
+
+#endif	/* RELINDEX_H */
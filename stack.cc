@@ -24,21 +24,48 @@
 bool
 Stack::push(const Item & item)   
 {
-  if (top < MAX)
+  const size_t k = key (item);
+  if (k < pending.size () && pending[k])
     {
-      items[top++] = item;
-      return true;
+      nduplicates++;
+      return false;
+    }
+  if (items.size () >= max)
+    {
+      if (!overflowed)
+	noverflows++;
+      overflowed = true;
+      ndropped++;
+      return false;
     }
-  return false;
+  items.push_back (item);
+  if (k >= pending.size ())
+    pending.resize (2 * k + 1, false);
+  pending[k] = true;
+  return true;
 }
 
 bool
 Stack::pop(Item & item)
 {
-  if (top > 0)
+  if (!items.empty ())
     {
-      item = items[--top];
+      item = items.back ();
+      items.pop_back ();
+      pending[key (item)] = false;
       return true;
     }
   return false; 
 }
+
+// Discard all items, counting them as dropped if the stack overflowed.
+void
+Stack::erase ()
+{
+  if (overflowed)
+    ndropped += items.size ();
+  for (size_t i = 0; i < items.size (); i++)
+    pending[key (items[i])] = false;
+  items.clear ();
+  overflowed = false;
+}
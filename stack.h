@@ -22,29 +22,57 @@
 #ifndef STACK_H_
 #define STACK_H_
 
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
 typedef struct
 {
-  int c;			/* coset */
+  int64_t c;			/* coset */
   int x;			/* generator */
 } deduction;
 
 typedef deduction Item;
 
+/* The stack grows as needed, up to a maximum number of items.  An
+   item that is already on the stack is not pushed a second time.  If
+   a push fails because the maximum has been reached, the stack
+   records that it has overflowed; the caller is then expected to
+   recover the lost information some other way (e.g., by lookahead)
+   and erase the stack. */
+
 class Stack
 {
 private:
-  enum {MAX = 1024};
-  Item items[MAX];    // holds stack items
-  int top;            // index just beyond end of stack
+  enum {DEFAULT_MAX = 1 << 20};
+  std::vector<Item> items;	// holds stack items
+  std::vector<bool> pending;	// pending[c * ncols + x]: (c, x) is on stack
+  size_t max;			// maximum number of items
+  int ncols;			// number of generators
+  bool overflowed;
+  unsigned long nduplicates;	// pushes skipped because already on stack
+  unsigned long ndropped;	// items lost to overflows
+  unsigned long noverflows;
+  size_t key (const Item & item) const
+  { return size_t (item.c) * ncols + item.x; }
 public:
-  Stack () { top = 0; };
-  bool is_empty () const { return top == 0; };
-  bool is_full () const { return top == MAX; };
-  // push() returns false if stack already is full, true otherwise
+  explicit Stack (int ngens, size_t m = DEFAULT_MAX)
+    : max (m), ncols (ngens), overflowed (false), nduplicates (0),
+      ndropped (0), noverflows (0) {};
+  bool is_empty () const { return items.empty (); };
+  bool has_overflowed () const { return overflowed; };
+  // push() returns false if item is already on the stack or the stack
+  // is full, true otherwise
   bool push (const Item & item);
   // pop() returns false if stack already is empty, true otherwise
   bool pop (Item & item);          // pop top into item
-  void erase () { top = 0; };
+  void erase ();
+  void set_max (size_t m) { max = m; };
+  size_t get_max () const { return max; };
+  unsigned long get_nduplicates () const { return nduplicates; };
+  unsigned long get_ndropped () const { return ndropped; };
+  unsigned long get_noverflows () const { return noverflows; };
+  const std::vector<Item>& contents () const { return items; };
 };
 
 #endif	/* STACK_H */
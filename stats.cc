@@ -0,0 +1,67 @@
+/* stats.cc: output of enumeration statistics.
+
+   Copyright 2012 Kenneth S. Brown.
+
+   This file is part of Toddcox.
+
+   Toddcox is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version (GPLv3+).
+
+   Toddcox is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Toddcox; if not, see <http://gnu.org/licenses/>.
+
+   Written by Ken Brown <kbrown@cornell.edu>. */
+
+#include "stats.h"
+
+using namespace std;
+
+EnumStats::EnumStats ()
+  : defined (0), gap_fills (0), deductions (0), coincidences (0), killed (0),
+    max_cascade (0), lookaheads (0), compressions (0), live (0),
+    max_live (0), max_rows (0), stack_overflows (0), deductions_dropped (0)
+{
+}
+
+void
+EnumStats::print (ostream& os) const
+{
+  os << "Cosets defined:          " << defined << "\n"
+     << "  from preferred list:   " << gap_fills << "\n"
+     << "Maximum live cosets:     " << max_live << "\n"
+     << "Maximum table size:      " << max_rows << "\n"
+     << "Deductions from scans:   " << deductions << "\n"
+     << "Coincidences:            " << coincidences << "\n"
+     << "Cosets killed:           " << killed << "\n"
+     << "Longest cascade:         " << max_cascade << "\n"
+     << "Lookahead passes:        " << lookaheads << "\n"
+     << "Compressions:            " << compressions << "\n"
+     << "Stack overflows:         " << stack_overflows << "\n"
+     << "Deductions dropped:      " << deductions_dropped << "\n";
+}
+
+// A single JSON object, without a trailing newline, so that callers
+// can embed it in a larger document.
+void
+EnumStats::print_json (ostream& os) const
+{
+  os << "{\"cosets_defined\": " << defined
+     << ", \"gap_fills\": " << gap_fills
+     << ", \"max_live_cosets\": " << max_live
+     << ", \"max_table_size\": " << max_rows
+     << ", \"deductions\": " << deductions
+     << ", \"coincidences\": " << coincidences
+     << ", \"cosets_killed\": " << killed
+     << ", \"max_cascade\": " << max_cascade
+     << ", \"lookahead_passes\": " << lookaheads
+     << ", \"compressions\": " << compressions
+     << ", \"stack_overflows\": " << stack_overflows
+     << ", \"deductions_dropped\": " << deductions_dropped << "}";
+}
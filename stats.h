@@ -0,0 +1,53 @@
+/* stats.h: counters describing the course of a coset enumeration.
+
+   Copyright 2012 Kenneth S. Brown.
+
+   This file is part of Toddcox.
+
+   Toddcox is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version (GPLv3+).
+
+   Toddcox is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Toddcox; if not, see <http://gnu.org/licenses/>.
+
+   Written by Ken Brown <kbrown@cornell.edu>. */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <iostream>
+
+/* The coset table keeps these counters up to date as it goes.  They
+   cost an increment here and there, so they are always on.  They
+   are meant to show why an enumeration behaves as it does: e.g., a
+   large number of definitions compared with the index, or long
+   coincidence cascades. */
+
+struct EnumStats
+{
+  EnumStats ();
+  unsigned long defined;	/* cosets defined */
+  unsigned long gap_fills;	/* of which from the preferred list */
+  unsigned long deductions;	/* deductions found by scanning */
+  unsigned long coincidences;	/* primary coincidences */
+  unsigned long killed;		/* cosets killed by coincidences */
+  unsigned long max_cascade;	/* most cosets killed by one coincidence */
+  unsigned long lookaheads;	/* lookahead passes */
+  unsigned long compressions;	/* calls to compress */
+  long live;			/* live cosets now */
+  long max_live;		/* most live cosets at any time */
+  long max_rows;		/* largest size of the table */
+  unsigned long stack_overflows; /* Felsch deduction stack */
+  unsigned long deductions_dropped;
+  void print (std::ostream&) const;
+  void print_json (std::ostream&) const;
+};
+
+#endif	/* STATS_H */
@@ -0,0 +1,177 @@
+/* table.cc: the Table class (coset table storage).
+
+   Copyright 2011 Kenneth S. Brown.
+
+   This file is part of Toddcox.
+
+   Toddcox is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version (GPLv3+).
+
+   Toddcox is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Toddcox; if not, see <http://gnu.org/licenses/>.
+
+   Written by Ken Brown <kbrown@cornell.edu>. */
+
+#include <config.h>
+
+#include <new>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <stdint.h>
+
+#include "table.h"
+
+using namespace std;
+
+template <class T, int N>
+Table<T, N>::~Table ()
+{
+#ifdef HAVE_SYS_MMAN_H
+  if (fd >= 0)
+    {
+      if (data)
+	munmap (data, nbytes (cap));
+      close (fd);
+      return;
+    }
+#endif
+  free (data);
+}
+
+template <class T, int N>
+void
+Table<T, N>::clear_row (long r)
+{
+  fill (row (r), row (r) + NCOLS, -1);
+}
+
+// Make room for at least n rows, at least doubling the capacity so
+// that add_row takes amortized constant time, but not beyond maxrows
+// unless n itself is larger.  Throw bad_alloc if memory (or disk
+// space) is exhausted, leaving the table unchanged.
+template <class T, int N>
+void
+Table<T, N>::grow (long n)
+{
+  const long minrows = 1024;
+  long newcap = max (n, min (max (2 * cap, minrows), maxrows));
+  if (fd < 0)
+    {
+      T* d = static_cast<T*> (realloc (data, nbytes (newcap)));
+      if (!d)
+	throw bad_alloc ();
+      data = d;
+      cap = newcap;
+      return;
+    }
+#ifdef HAVE_SYS_MMAN_H
+  // Allocate the disk blocks now; otherwise a full disk would show up
+  // later as a SIGBUS on some write to the mapping.
+#ifdef HAVE_POSIX_FALLOCATE
+  if (posix_fallocate (fd, 0, nbytes (newcap)) != 0)
+    throw bad_alloc ();
+#else
+  if (ftruncate (fd, nbytes (newcap)) != 0)
+    throw bad_alloc ();
+#endif
+  void* d;
+  if (!data)
+    d = mmap (0, nbytes (newcap), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  else
+#ifdef HAVE_MREMAP
+    d = mremap (data, nbytes (cap), nbytes (newcap), MREMAP_MAYMOVE);
+#else
+    {
+      munmap (data, nbytes (cap));
+      d = mmap (0, nbytes (newcap), PROT_READ | PROT_WRITE, MAP_SHARED,
+		fd, 0);
+    }
+#endif
+  if (d == MAP_FAILED)
+    throw bad_alloc ();
+  data = static_cast<T*> (d);
+  cap = newcap;
+#endif
+}
+
+// Move the table into a memory-mapped file, which is created (or
+// truncated) and then unlinked.  Return false if the file can't be
+// set up, in which case the table stays where it was.
+template <class T, int N>
+bool
+Table<T, N>::use_file (const string& fname)
+{
+#ifdef HAVE_SYS_MMAN_H
+  if (fd >= 0)
+    return false;
+  int newfd = open (fname.c_str (), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (newfd < 0)
+    return false;
+  remove (fname.c_str ());
+  T* olddata = data;
+  const long oldcap = cap;
+  data = 0;
+  cap = 0;
+  fd = newfd;
+  try
+    {
+      grow (max (oldcap, 1L));
+    }
+  catch (bad_alloc&)
+    {
+      close (fd);
+      fd = -1;
+      data = olddata;
+      cap = oldcap;
+      return false;
+    }
+  copy (olddata, olddata + offset (nrows), data);
+  free (olddata);
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Tell the operating system that rows r,...,r+n-1 will be needed
+// soon, so that a file-backed table can read them in ahead of time.
+template <class T, int N>
+void
+Table<T, N>::willneed (long r, long n) const
+{
+#ifdef HAVE_SYS_MMAN_H
+  if (fd < 0 || r >= nrows)
+    return;
+  n = min (n, nrows - r);
+  const long pagesize = sysconf (_SC_PAGESIZE);
+  size_t begin = nbytes (r) / pagesize * pagesize;
+  size_t end = nbytes (r + n);
+  madvise (reinterpret_cast<char*> (data) + begin, end - begin,
+	   MADV_WILLNEED);
+#endif
+}
+
+template class Table<int16_t, 0>;
+template class Table<int16_t, 4>;
+template class Table<int16_t, 6>;
+template class Table<int32_t, 0>;
+template class Table<int32_t, 4>;
+template class Table<int32_t, 6>;
+template class Table<int64_t, 0>;
+template class Table<int64_t, 4>;
+template class Table<int64_t, 6>;
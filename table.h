@@ -0,0 +1,111 @@
+/* table.h: declarations for the Table class (coset table storage).
+
+   Copyright 2011 Kenneth S. Brown.
+
+   This file is part of Toddcox.
+
+   Toddcox is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version (GPLv3+).
+
+   Toddcox is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Toddcox; if not, see <http://gnu.org/licenses/>.
+
+   Written by Ken Brown <kbrown@cornell.edu>. */
+
+#ifndef TABLE_H
+#define TABLE_H
+
+#include <string>
+#include <cstddef>
+#include <climits>
+
+/* A Table is a rectangular array of integers of type T (a signed
+   type wide enough for the row numbers) with a fixed number of
+   columns and a growing number of rows.  The entries are kept in one
+   contiguous buffer, row after row, so that entry (r, c) lives at
+   offset r * ncols + c.  This avoids a separate heap allocation for
+   every row and keeps neighboring rows close together in memory.
+   New rows are filled with -1.
+
+   By default the buffer lives on the heap.  After a call to use_file
+   it is instead a shared memory mapping of a file, so that the table
+   can grow beyond the available RAM; the operating system then pages
+   rows in and out as they are used.  The file is unlinked as soon as
+   it has been opened, so that it disappears when the program exits,
+   however that happens. */
+
+/* A Width<N> converts to the constant N, or, if N is 0, to a number
+   fixed when it is constructed.  Storing the number of columns as a
+   Width lets a table with N columns known at compile time index its
+   rows with constant offsets and unroll loops over a row, while N = 0
+   gives a table that works for any number of columns. */
+
+template <int N>
+class Width
+{
+ public:
+  explicit Width (int) {}
+  operator int () const { return N; }
+};
+
+template <>
+class Width<0>
+{
+ public:
+  explicit Width (int n) : n (n) {}
+  operator int () const { return n; }
+ private:
+  int n;
+};
+
+template <class T, int N = 0>
+class Table
+{
+ public:
+  explicit Table (int ncols = N)
+    : NCOLS (ncols), nrows (0), cap (0), maxrows (LONG_MAX), data (0),
+      fd (-1) {}
+  ~Table ();
+  long size () const { return nrows; }
+  int ncols () const { return NCOLS; }
+  T& operator () (long r, int c) { return data[offset (r) + c]; }
+  T operator () (long r, int c) const { return data[offset (r) + c]; }
+  T* row (long r) { return data + offset (r); }
+  const T* row (long r) const { return data + offset (r); }
+  long add_row ()
+  { if (nrows == cap) grow (nrows + 1); clear_row (nrows); return nrows++; }
+  void clear_row (long r);
+  void truncate (long n) { if (n < nrows) nrows = n; }
+  void reserve (long n) { if (n > cap) grow (n); }
+  /* Never allocate more than n rows ahead of need. */
+  void set_max_rows (long n) { maxrows = n; }
+  bool use_file (const std::string& filename);
+  void willneed (long r, long n) const;
+  void prefetch (long r, int c) const
+  {
+#ifdef __GNUC__
+    __builtin_prefetch (data + offset (r) + c);
+#endif
+  }
+ private:
+  Table (const Table&);
+  Table& operator= (const Table&);
+  Width<N> NCOLS;
+  long nrows;
+  long cap;			/* number of rows allocated */
+  long maxrows;			/* cap for the doubling in grow */
+  T* data;
+  int fd;			/* file descriptor, or -1 if on heap */
+  size_t offset (long r) const { return size_t (r) * NCOLS; }
+  size_t nbytes (long rows) const { return offset (rows) * sizeof (T); }
+  void grow (long n);
+};
+
+#endif	/* TABLE_H */
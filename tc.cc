@@ -21,15 +21,32 @@
 
 #include <iostream>
 #include <vector>
+#include <cstdlib>
 
 #include "cosettable.h"
 #include "gens_and_words.h"
+#include "alphabet.h"
 #include "tc.h"
 
 using namespace std;
 
-TC::TC (istream* inp, bool felsch, int threshold)
-  : input (inp), enum_method (felsch ? -1 : threshold)
+TC::TC (istream* inp, bool felsch, int threshold, long maxcosets)
+  : input (inp),
+    enum_method (felsch ? int (CosetTableBase::FELSCH) : threshold)
+{
+  read_group (maxcosets);
+}
+
+TC::TC (istream* inp, const Strategy& s, long maxcosets)
+  : input (inp), enum_method (CosetTableBase::HYBRID)
+{
+  read_group (maxcosets);
+  ctp->set_strategy (s);
+}
+
+// Read the group and subgroup from input and make the coset table.
+void
+TC::read_group (long maxcosets)
 {
   const string instruct =
     "\nThis program uses the Todd-Coxeter procedure to compute the\n"
@@ -37,15 +54,29 @@ TC::TC (istream* inp, bool felsch, int threshold)
     "will be prompted to enter the number of generators of G, the\n"
     "defining relators of G, and the generators of H.  Use\n"
     "a,b,... for the generators of G and A,B,... for their\n"
-    "inverses.\n\n";
-  int NGENS;
+    "inverses.  To use other names, type them after the number\n"
+    "of generators, and separate them by spaces in words, as in\n"
+    "x1 x2 X1; a^3 and (ab)^2 are also allowed.\n\n";
+  Alphabet A;
   vector<string> rel, gen_H;
   if (input == &cin)
     cout << instruct;
-  getgroup (NGENS, rel, gen_H, input);
+  getgroup (A, rel, gen_H, input);
   if (input != &cin)
     delete input;		// Does this close file?
-  ctp = new CosetTable (NGENS, rel, gen_H, felsch);
+  ctp = new_coset_table (A, rel, gen_H, enum_method, maxcosets);
+}
+
+// Carry on with an enumeration saved in a checkpoint file.
+TC::TC (const string& checkpoint)
+  : input (0)
+{
+  ctp = open_checkpoint (checkpoint, enum_method);
+  if (!ctp)
+    {
+      cerr << checkpoint << " is not a checkpoint file.\n";
+      exit (1);
+    }
 }
   
 void
@@ -56,3 +87,13 @@ TC::display_table (ostream* outp, bool standardize)
     ctp->standardize ();
   *outp << *ctp;
 }
+
+// Compress and standardize the table, and write it in the binary
+// format described in cosettable.h.  Return false on error.
+bool
+TC::write_binary_table (ostream& os)
+{
+  ctp->compress ();
+  ctp->standardize ();
+  return ctp->write_binary (os);
+}
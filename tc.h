@@ -23,22 +23,44 @@
 #define TC_H
 
 #include <iostream>
+#include <string>
 
 #include "cosettable.h"
 
 class TC
 {
 public:
-  TC (std::istream*, bool, int);
+  TC (std::istream*, bool, int, long maxcosets = 0);
+  TC (std::istream*, const Strategy&, long maxcosets = 0);
+  explicit TC (const std::string& checkpoint);
   ~TC () { delete ctp; }
   void enumerate () const { ctp->enumerate (enum_method); }
-  int index () const { return ctp->getnlive (); }
-  int table_size () const { return ctp->getsize (); }
+  long index () const { return ctp->getnlive (); }
+  long table_size () const { return ctp->getsize (); }
+  int coset_bits () const { return ctp->coset_bits (); }
+  bool felsch () const { return enum_method < 0; }	/* or hybrid */
+  unsigned long cosets_defined () const { return ctp->getstats ().defined; }
+  bool use_table_file (const std::string& f)
+  { return ctp->use_table_file (f); }
+  void set_deduction_limit (size_t n) { ctp->set_deduction_limit (n); }
+  void set_threads (int n) { ctp->set_threads (n); }
+  void set_gap_fill (bool g) { ctp->set_gap_fill (g); }
+  void set_renumbering (bool r) { ctp->set_renumbering (r); }
+  void set_memory_limit (size_t bytes) { ctp->set_memory_limit (bytes); }
+  void set_progress (std::ostream* os, int seconds)
+  { ctp->set_progress (os, seconds); }
+  void set_checkpoint (const std::string& file, int seconds)
+  { ctp->set_checkpoint (file, seconds); }
+  unsigned long deductions_dropped () const { return ctp->get_ndropped (); }
+  unsigned long stack_overflows () const { return ctp->get_noverflows (); }
+  EnumStats stats () const { return ctp->getstats (); }
   void display_table (std::ostream*, bool standardize = false);
+  bool write_binary_table (std::ostream&);
 private:
+  void read_group (long maxcosets);
   std::istream* input;
   int enum_method;		/* see cosettable.h */
-  CosetTable* ctp;
+  CosetTableBase* ctp;
 };
 
 
@@ -27,82 +27,259 @@
 #include <fstream>
 #include <string>
 #include <cstdlib>
+#include <csignal>
 #include <getopt.h>
 #include "tc.h"
+#include "batch.h"
+#include "lowindex.h"
+#include "alphabet.h"
 #include <config.h>
 
 using namespace std;
 
+// Command-line options; see help ().
+struct Options
+{
+  Options ()
+    : fileind (0), felsch (false), threshold (0), deduction_limit (0),
+      maxcosets (0), nthreads (1), progress_interval (0),
+      checkpoint_interval (0), memory_limit (0), hybrid (false),
+      gap_fill (false), renumber (false), low_index (0) {}
+  int fileind;			// index of input file in argv, or 0
+  bool felsch;
+  int threshold;
+  long deduction_limit;
+  string table_file;
+  long maxcosets;
+  int nthreads;
+  string stats_format;
+  int progress_interval;
+  string progress_file;
+  string checkpoint_file;
+  int checkpoint_interval;
+  string resume_file;
+  string binary_file;
+  string batch_file;
+  size_t memory_limit;
+  bool hybrid;
+  Strategy strategy;
+  bool gap_fill;
+  bool renumber;
+  int low_index;
+};
+
 void usage ();
 void help ();
-void parse_args (int, char **, int&, bool&, int&);
+void parse_args (int, char **, Options&);
+size_t parse_size (const char*);
 void version ();
 void gen_progname (const string&);
 ostream* getfout ();
 
 static string progname;
 
+extern "C" void
+on_sigterm (int)
+{
+  checkpoint_requested = 1;
+}
+
 int
 main (int argc, char *argv[])
 {
-  bool felsch = false;
-  int threshold = 0;
-  int fileind = 0;
+  Options opt;
 
   gen_progname (argv[0]);
-  parse_args (argc, argv, fileind, felsch, threshold);
+  parse_args (argc, argv, opt);
 
-  istream *input = &cin;
-  if (fileind > 0)
+  if (!opt.batch_file.empty ())
     {
-      input = new ifstream (argv[fileind]);
-      if (!*input)
+      ifstream manifest (opt.batch_file.c_str ());
+      if (!manifest)
 	{
-	  cerr << "Unable to open " << argv[fileind] << endl;
-	  delete input;
+	  cerr << "Unable to open " << opt.batch_file << endl;
 	  exit (1);
 	}
+      int nfailed = run_batch (manifest, cout, opt.nthreads, opt.maxcosets);
+      return nfailed == 0 ? 0 : 1;
+    }
+
+  if (opt.low_index > 0)
+    {
+      istream *input = &cin;
+      if (opt.fileind > 0)
+	{
+	  input = new ifstream (argv[opt.fileind]);
+	  if (!*input)
+	    {
+	      cerr << "Unable to open " << argv[opt.fileind] << endl;
+	      delete input;
+	      exit (1);
+	    }
+	}
+      Alphabet A;
+      vector<string> rel, gen_H;
+      getgroup (A, rel, gen_H, input);
+      if (input != &cin)
+	delete input;
+      LowIndex li (A, rel, gen_H, opt.low_index);
+      li.search (opt.nthreads);
+      cout << "# " << li.subgroups ().size ()
+	   << " conjugacy classes of subgroups of index at most "
+	   << opt.low_index << " (" << li.nodes () << " nodes searched)\n";
+      li.print (cout);
+      return 0;
     }
 
-  TC tc (input, felsch, threshold);
-  tc.enumerate ();
-  int index = tc.index ();
+  TC* tcp;
+  if (!opt.resume_file.empty ())
+    tcp = new TC (opt.resume_file);
+  else
+    {
+      istream *input = &cin;
+      if (opt.fileind > 0)
+	{
+	  input = new ifstream (argv[opt.fileind]);
+	  if (!*input)
+	    {
+	      cerr << "Unable to open " << argv[opt.fileind] << endl;
+	      delete input;
+	      exit (1);
+	    }
+	}
+      if (opt.hybrid)
+	tcp = new TC (input, opt.strategy, opt.maxcosets);
+      else
+	tcp = new TC (input, opt.felsch, opt.threshold, opt.maxcosets);
+    }
+  TC& tc = *tcp;
+  if (opt.deduction_limit > 0)
+    tc.set_deduction_limit (opt.deduction_limit);
+  tc.set_threads (opt.nthreads);
+  if (opt.resume_file.empty ())	// else they come from the checkpoint
+    {
+      tc.set_gap_fill (opt.gap_fill);
+      tc.set_renumbering (opt.renumber);
+    }
+  if (opt.memory_limit > 0)
+    tc.set_memory_limit (opt.memory_limit);
+  ofstream progress_out;
+  if (opt.progress_interval > 0)
+    {
+      if (!opt.progress_file.empty ())
+	{
+	  progress_out.open (opt.progress_file.c_str ());
+	  if (!progress_out)
+	    {
+	      cerr << "Unable to open " << opt.progress_file << endl;
+	      exit (1);
+	    }
+	}
+      tc.set_progress (opt.progress_file.empty () ? &cerr : &progress_out,
+		       opt.progress_interval);
+    }
+  if (!opt.table_file.empty () && !tc.use_table_file (opt.table_file))
+    {
+      cerr << "Unable to keep the coset table in " << opt.table_file << endl;
+      exit (1);
+    }
+  // A resumed enumeration goes on saving to the file it came from.
+  if (opt.checkpoint_file.empty ())
+    opt.checkpoint_file = opt.resume_file;
+  if (!opt.checkpoint_file.empty ())
+    {
+      tc.set_checkpoint (opt.checkpoint_file, opt.checkpoint_interval);
+      signal (SIGTERM, on_sigterm);
+    }
+  try
+    {
+      tc.enumerate ();
+    }
+  catch (CosetTableBase::Enumeration_Failed& e)
+    {
+      cout.flush ();
+      cerr << "\n\n" << e.reason << endl;
+      exit (EXIT_FAILURE);
+    }
+  long index = tc.index ();
   cout << "\nThe index of H in G is " << index
        << ".\nThe coset table had size " << tc.table_size ()
-       << " before compression.\n\n";
+       << " before compression.\n";
+  if (tc.felsch ())
+    cout << "The deduction stack overflowed " << tc.stack_overflows ()
+	 << " times; " << tc.deductions_dropped ()
+	 << " deductions were dropped.\n";
+  if (opt.stats_format == "text")
+    {
+      cout << "\n";
+      tc.stats ().print (cout);
+    }
+  else if (opt.stats_format == "json")
+    {
+      // On stderr, so that it can be captured apart from the table.
+      cerr << "{\"index\": " << index << ", \"table_size\": "
+	   << tc.table_size () << ", \"stats\": ";
+      tc.stats ().print_json (cerr);
+      cerr << "}" << endl;
+    }
+  cout << "\n";
+  if (!opt.binary_file.empty ())
+    {
+      ofstream out (opt.binary_file.c_str (), ios::binary);
+      if (!out || !tc.write_binary_table (out))
+	{
+	  cerr << "Unable to write " << opt.binary_file << endl;
+	  exit (1);
+	}
+      delete tcp;
+      return 0;
+    }
   ostream *output = &cout;
-  bool standardize = true;
   const int display_max = 50;
   if (index < display_max)
       cout << "Compressed and standardized coset table:\n\n";
   else			// Offer to print table to file
-    {
-      standardize = false;
-      output = getfout ();
-    }
+    output = getfout ();
   if (output)
     {
-      tc.display_table (output, standardize);
+      tc.display_table (output, true);
       if (output != &cout)
 	delete output;
     }
+  delete tcp;
 }
 
 void
-parse_args (int argc, char *argv[], int& fileind, bool& felsch,
-	    int& threshold)
+parse_args (int argc, char *argv[], Options& o)
 {
   const struct option long_options[] =
     {
       {"felsch",    no_argument,       NULL, 'f'},
       {"threshold", required_argument, NULL, 't'},
+      {"deduction-limit", required_argument, NULL, 'd'},
+      {"table-file", required_argument, NULL, 'm'},
+      {"max-cosets", required_argument, NULL, 'M'},
+      {"threads",   required_argument, NULL, 'j'},
+      {"stats",     optional_argument, NULL, 's'},
+      {"progress",  required_argument, NULL, 'p'},
+      {"progress-file", required_argument, NULL, 'P'},
+      {"checkpoint", required_argument, NULL, 'c'},
+      {"checkpoint-interval", required_argument, NULL, 'C'},
+      {"resume",    required_argument, NULL, 'r'},
+      {"binary-table", required_argument, NULL, 'b'},
+      {"batch",     required_argument, NULL, 'B'},
+      {"max-memory", required_argument, NULL, 'L'},
+      {"hybrid",    required_argument, NULL, 'y'},
+      {"gap-fill",  no_argument,       NULL, 'g'},
+      {"renumber",  no_argument,       NULL, 'R'},
+      {"low-index", required_argument, NULL, 'l'},
       {"help",	    no_argument,       NULL, 'h'},
       {"usage",	    no_argument,       NULL, 'u'},
       {"version",   no_argument,       NULL, 'v'},
       {NULL,	    no_argument,       NULL,  0 }
     };
 
-  const char *short_options = "ft:hvu";
+  const char *short_options = "ft:d:m:M:j:p:P:c:C:r:b:B:L:y:gRl:hvu";
 
   int opt;
   while ((opt = getopt_long (argc, argv, short_options, long_options, NULL))
@@ -111,10 +288,99 @@ parse_args (int argc, char *argv[], int& fileind, bool& felsch,
       switch (opt)
 	{
 	case 'f':
-	  felsch = true;
+	  o.felsch = true;
 	  break;
 	case 't':
-	  if ((threshold = atoi (optarg)) <= 0)
+	  if ((o.threshold = atoi (optarg)) <= 0)
+	    {
+	      usage ();
+	      exit (1);
+	    }
+	  break;
+	case 'd':
+	  if ((o.deduction_limit = atol (optarg)) <= 0)
+	    {
+	      usage ();
+	      exit (1);
+	    }
+	  break;
+	case 'm':
+	  o.table_file = optarg;
+	  break;
+	case 'M':
+	  if ((o.maxcosets = atol (optarg)) <= 0)
+	    {
+	      usage ();
+	      exit (1);
+	    }
+	  break;
+	case 'j':
+	  if ((o.nthreads = atoi (optarg)) <= 0)
+	    {
+	      usage ();
+	      exit (1);
+	    }
+	  break;
+	case 's':
+	  o.stats_format = optarg ? optarg : "text";
+	  if (o.stats_format != "text" && o.stats_format != "json")
+	    {
+	      usage ();
+	      exit (1);
+	    }
+	  break;
+	case 'p':
+	  if ((o.progress_interval = atoi (optarg)) <= 0)
+	    {
+	      usage ();
+	      exit (1);
+	    }
+	  break;
+	case 'P':
+	  o.progress_file = optarg;
+	  break;
+	case 'c':
+	  o.checkpoint_file = optarg;
+	  break;
+	case 'C':
+	  if ((o.checkpoint_interval = atoi (optarg)) <= 0)
+	    {
+	      usage ();
+	      exit (1);
+	    }
+	  break;
+	case 'r':
+	  o.resume_file = optarg;
+	  break;
+	case 'b':
+	  o.binary_file = optarg;
+	  break;
+	case 'B':
+	  o.batch_file = optarg;
+	  break;
+	case 'g':
+	  o.gap_fill = true;
+	  break;
+	case 'R':
+	  o.renumber = true;
+	  break;
+	case 'l':
+	  if ((o.low_index = atoi (optarg)) <= 0)
+	    {
+	      usage ();
+	      exit (1);
+	    }
+	  break;
+	case 'y':
+	  o.hybrid = true;
+	  if (!parse_strategy (optarg, o.strategy))
+	    {
+	      usage ();
+	      exit (1);
+	    }
+	  break;
+	case 'L':
+	  if ((o.memory_limit = parse_size (optarg)) == 0)
 	    {
 	      usage ();
 	      exit (1);
@@ -135,7 +401,11 @@ parse_args (int argc, char *argv[], int& fileind, bool& felsch,
 	}
     }
 
-  if (felsch && (threshold > 0))
+  if ((o.felsch + (o.threshold > 0) + o.hybrid) > 1
+      || (o.gap_fill && !o.felsch && !o.hybrid)
+      || (o.renumber && o.threshold == 0)
+      || (o.low_index > 0 && (o.felsch || o.threshold > 0 || o.hybrid
+			      || !o.resume_file.empty ())))
     {
       usage ();
       exit (1);
@@ -147,14 +417,45 @@ parse_args (int argc, char *argv[], int& fileind, bool& felsch,
       exit (1);
     }
   if (optind == argc - 1)
-    fileind = optind;
+    o.fileind = optind;
+
+  // The checkpoint determines the group and the method, with its
+  // options.
+  if (!o.resume_file.empty ()
+      && (o.fileind > 0 || o.felsch || o.threshold > 0 || o.hybrid
+	  || o.gap_fill || o.renumber || o.maxcosets > 0))
+    {
+      usage ();
+      exit (1);
+    }
+}
+
+// Parse a size such as 512M or 8G.  Return 0 if s is invalid.
+size_t
+parse_size (const char* s)
+{
+  char* end;
+  double n = strtod (s, &end);
+  const string units = "KMGT";
+  if (*end && end[1] == '\0' && units.find (toupper (*end)) != string::npos)
+    for (size_t i = 0; i <= units.find (toupper (*end)); i++)
+      n *= 1024;
+  else if (*end)
+    return 0;
+  return n >= 1 ? size_t (n) : 0;
 }
 
 void
 usage ()
 {
   cerr << "\
-Usage: " << progname << " [-t THRESHOLD | -f]  [FILE]\n\n\
+Usage: " << progname << " [-t THRESHOLD | -f | -y H,F[,L]] [-g] [-d LIMIT]\
+  [-R] [-m TABLEFILE]\
+  [-M MAXCOSETS] [-L SIZE] [-j THREADS] [-p SECONDS [-P PROGRESSFILE]]\
+  [-c CHECKPOINT [-C SECONDS]] [-b TABLEOUT] [--stats[=FORMAT]]\
+  [FILE | -r CHECKPOINT]\n\
+       " << progname << " -B MANIFEST [-j THREADS] [-M MAXCOSETS]\n\
+       " << progname << " -l INDEX [-j THREADS] [FILE]\n\n\
 Try `" << progname << " --help' for more information.\n";
 }
 
@@ -168,7 +469,7 @@ If FILE is specified, it should contain the information about the\n\
 group and subgroup.  If it is not specified, the user is prompted\n\
 for that information.\n\n\
 The HLT coset enumeration method is used unless one of the (mutually\n\
-exclusive) options -t or -f is given.\n\n\
+exclusive) options -t, -f or -y is given.\n\n\
 Options:\n\n\
   -f, --felsch               Use the Felsch enumeration method.\n\
   -t, --threshold=THRESHOLD  Use the HLT+lookahead method.  This means\n\
@@ -177,6 +478,112 @@ Options:\n\n\
                              will not continue unless the table size\n\
                              can be reduced.  THRESHOLD must be a\n\
                              positive integer.\n\
+  -y, --hybrid=H,F[,L]       Alternate between HLT and Felsch, in the\n\
+                             style of ACE: process H cosets as in HLT,\n\
+                             then F cosets as in Felsch, and so on,\n\
+                             following up deductions throughout.  If L\n\
+                             is given, look ahead over the whole table\n\
+                             every time L more cosets are defined.\n\
+  -g, --gap-fill             With -f or -y, prefer to make definitions\n\
+                             that complete a relator scan at once (the\n\
+                             preferred definition list of Holt and\n\
+                             ACE).  This often reduces the number of\n\
+                             cosets needed.\n\
+  -R, --renumber             With -t, renumber the cosets after each\n\
+                             lookahead, so that neighbouring cosets are\n\
+                             stored close together.  This often speeds\n\
+                             up the lookahead passes over large tables,\n\
+                             but needs two extra words per row while it\n\
+                             runs.\n\
+  -d, --deduction-limit=LIMIT\n\
+                             With -f or -y, keep at most LIMIT pending\n\
+                             deductions (default 1048576).  If more\n\
+                             are found, they are dropped and recovered\n\
+                             by a lookahead pass over the whole table.\n\
+  -m, --table-file=TABLEFILE Keep the coset table in a memory-mapped\n\
+                             file called TABLEFILE instead of in RAM.\n\
+                             This allows the table to grow beyond the\n\
+                             available memory, at the cost of speed.\n\
+                             TABLEFILE should be on a local disk with\n\
+                             enough free space; it is removed when\n\
+                             the program exits.\n\
+  -M, --max-cosets=MAXCOSETS Keep the coset table within MAXCOSETS\n\
+                             rows.  When the table is nearly full, the\n\
+                             rows of dead cosets are reused, and HLT\n\
+                             looks ahead to free some more; if that\n\
+                             doesn't free enough, it carries on by the\n\
+                             Felsch method, which needs fewer rows at\n\
+                             a time, and the enumeration fails only if\n\
+                             there isn't room even for that.  Coset\n\
+                             numbers are stored in 16, 32 or 64 bits,\n\
+                             whichever is the smallest that can hold\n\
+                             MAXCOSETS (or the largest table that\n\
+                             THRESHOLD allows).  Without either, 32\n\
+                             bits are used.\n\
+  -L, --max-memory=SIZE      Keep the coset table and the bookkeeping\n\
+                             that grows with it, including the\n\
+                             deduction stack, within SIZE bytes (a\n\
+                             number, optionally followed by K, M, G or\n\
+                             T).  This limits the number of rows as\n\
+                             -M does, with the same recourse when the\n\
+                             table is nearly full, and lowers the\n\
+                             deduction limit (-d) if necessary.\n\
+  -l, --low-index=INDEX      Instead of enumerating the cosets of H,\n\
+                             list the subgroups of G of index at most\n\
+                             INDEX that contain H, one from each\n\
+                             conjugacy class, with their index, whether\n\
+                             they are normal and generators for them\n\
+                             (see lowindex.h).\n\
+  -j, --threads=THREADS      Use THREADS threads (default 1).  With HLT\n\
+                             and HLT+lookahead, the threads process\n\
+                             blocks of cosets together: each carries\n\
+                             out the HLT steps for its part of a block\n\
+                             against the table as it was at the start\n\
+                             of the block, and then their definitions\n\
+                             and deductions are merged into the table\n\
+                             and the coincidences are processed.  The\n\
+                             result is the same for any number of\n\
+                             threads from 2 up, but the table usually\n\
+                             grows larger than with one thread.  Passes\n\
+                             of lookahead over the whole table are\n\
+                             shared among the threads too.  With -l,\n\
+                             they share the search.\n\
+  -p, --progress=SECONDS     Every SECONDS seconds, report the coset\n\
+                             being processed, the table size, the\n\
+                             number of live cosets and the rate at\n\
+                             which cosets are being defined.\n\
+  -P, --progress-file=PROGRESSFILE\n\
+                             Write the progress reports to\n\
+                             PROGRESSFILE instead of standard error.\n\
+  -c, --checkpoint=CHECKPOINT\n\
+                             Save the state of the enumeration in the\n\
+                             file CHECKPOINT when the program receives\n\
+                             SIGTERM (and then exit), and also every\n\
+                             SECONDS seconds if -C is given.\n\
+  -C, --checkpoint-interval=SECONDS\n\
+                             See -c.\n\
+  -r, --resume=CHECKPOINT    Carry on with the enumeration saved in\n\
+                             CHECKPOINT, instead of starting a new one.\n\
+                             The group, subgroup and method (along\n\
+                             with -g and -R) are taken from CHECKPOINT,\n\
+                             so FILE, -f, -t, -y, -g, -R and -M may not\n\
+                             be given.  Further checkpoints are saved\n\
+                             in CHECKPOINT unless -c is given.\n\
+  -b, --binary-table=TABLEOUT\n\
+                             Write the compressed and standardized\n\
+                             coset table to TABLEOUT in a binary form\n\
+                             that other programs can mmap (see\n\
+                             cosettable.h), instead of offering to\n\
+                             print it.\n\
+  -B, --batch=MANIFEST       Run all the enumerations listed in MANIFEST,\n\
+                             THREADS at a time, and print one line of\n\
+                             results for each (see batch.h for the\n\
+                             format of MANIFEST).\n\
+      --stats[=FORMAT]       Report statistics about the enumeration:\n\
+                             cosets defined, deductions, coincidences,\n\
+                             lookahead passes, etc.  FORMAT is `text'\n\
+                             (the default) or `json'; JSON output goes\n\
+                             to standard error.\n\
   -v, --version              Print version information and exit.\n\
   -u, --usage                Print a brief usage message and exit.\n\
   -h, --help                 Print this help text and exit.\n";
@@ -0,0 +1,101 @@
+/* workerpool.cc: the WorkerPool class.
+
+   Copyright 2011 Kenneth S. Brown.
+
+   This file is part of Toddcox.
+
+   Toddcox is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version (GPLv3+).
+
+   Toddcox is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Toddcox; if not, see <http://gnu.org/licenses/>.
+
+   Written by Ken Brown <kbrown@cornell.edu>. */
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "workerpool.h"
+
+using namespace std;
+
+// Start nthreads - 1 workers; the caller of run is the last thread.
+WorkerPool::WorkerPool (int nthreads)
+  : job (0), ntasks (0), next (0), busy (0), generation (0), stopping (false)
+{
+  for (int i = 1; i < nthreads; i++)
+    workers.push_back (thread (&WorkerPool::work, this));
+}
+
+WorkerPool::~WorkerPool ()
+{
+  {
+    lock_guard<mutex> lock (m);
+    stopping = true;
+  }
+  start.notify_all ();
+  for (size_t i = 0; i < workers.size (); i++)
+    workers[i].join ();
+}
+
+void
+WorkerPool::do_tasks ()
+{
+  int i;
+  while ((i = next++) < ntasks)
+    (*job) (i);
+}
+
+void
+WorkerPool::work ()
+{
+  unsigned long seen = 0;
+  for (;;)
+    {
+      {
+	unique_lock<mutex> lock (m);
+	start.wait (lock, [&] { return stopping || generation != seen; });
+	if (stopping)
+	  return;
+	seen = generation;
+      }
+      do_tasks ();
+      {
+	lock_guard<mutex> lock (m);
+	if (--busy == 0)
+	  finish.notify_one ();
+      }
+    }
+}
+
+void
+WorkerPool::run (int n, const function<void (int)>& task)
+{
+  if (workers.empty ())
+    {
+      for (int i = 0; i < n; i++)
+	task (i);
+      return;
+    }
+  {
+    lock_guard<mutex> lock (m);
+    job = &task;
+    ntasks = n;
+    next = 0;
+    busy = workers.size ();
+    generation++;
+  }
+  start.notify_all ();
+  do_tasks ();
+  unique_lock<mutex> lock (m);
+  finish.wait (lock, [&] { return busy == 0; });
+}
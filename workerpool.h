@@ -0,0 +1,62 @@
+/* workerpool.h: declarations for the WorkerPool class.
+
+   Copyright 2011 Kenneth S. Brown.
+
+   This file is part of Toddcox.
+
+   Toddcox is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version (GPLv3+).
+
+   Toddcox is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Toddcox; if not, see <http://gnu.org/licenses/>.
+
+   Written by Ken Brown <kbrown@cornell.edu>. */
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+/* A WorkerPool keeps a fixed set of threads waiting for work, so that
+   a loop can be run in parallel many times without paying for thread
+   creation each time.  run (n, task) calls task (i) for i = 0,...,
+   n-1, in no particular order, using the pool's threads together with
+   the calling thread, and returns when all the calls have finished.
+   The tasks must not modify shared data without synchronization. */
+
+class WorkerPool
+{
+ public:
+  explicit WorkerPool (int nthreads);
+  ~WorkerPool ();
+  int size () const { return workers.size () + 1; }
+  void run (int n, const std::function<void (int)>& task);
+ private:
+  WorkerPool (const WorkerPool&);
+  WorkerPool& operator= (const WorkerPool&);
+  std::vector<std::thread> workers;
+  std::mutex m;
+  std::condition_variable start, finish;
+  const std::function<void (int)>* job;
+  int ntasks;
+  std::atomic<int> next;	/* next task to hand out */
+  int busy;			/* workers still working on this job */
+  unsigned long generation;	/* number of jobs started */
+  bool stopping;
+  void work ();
+  void do_tasks ();
+};
+
+#endif	/* WORKERPOOL_H */